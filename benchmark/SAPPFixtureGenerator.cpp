@@ -0,0 +1,27 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "SAPPFixture.h"
+
+//Writes a generated Steam tree to disk and leaves it there, e.g. for profiling with HOME pointed at it.
+//Usage: SAPP_fixture <root> [manifests] [libraries] [extra folders per install]
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <root> [manifests] [libraries] [extra folders per install]" << std::endl;
+        return 1;
+    }
+
+    SappFakeSteamTreeOptions options;
+    options.root = argv[1];
+    options.keep = true;
+    if (argc > 2)
+        options.manifests = static_cast<unsigned int>(std::stoul(argv[2]));
+    if (argc > 3)
+        options.libraries = static_cast<unsigned int>(std::stoul(argv[3]));
+    if (argc > 4)
+        options.extraFolders = static_cast<unsigned int>(std::stoul(argv[4]));
+
+    SappFakeSteamTree tree(options);
+    std::cout << "HOME=" << tree.Root().string() << " (" << tree.appids.size() << " apps in " << tree.libraries.size() << " libraries)" << std::endl;
+    return 0;
+}
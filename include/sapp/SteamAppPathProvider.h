@@ -2,10 +2,36 @@
 
 #include <fstream>
 #include <filesystem>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <algorithm>
 #include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <span>
+#include <ranges>
+#include <bit>
+#include <charconv>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <set>
+#include <stop_token>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <tuple>
 
 #if defined( __GNUC__ ) && !defined( _WIN32 ) && !defined( POSIX )
 #if __GNUC__ < 4
@@ -19,6 +45,25 @@
 #define CORRECT_PATH_SEPARATOR	 '\\'
 #define INCORRECT_PATH_SEPARATOR '/'
 #elif POSIX
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+// SAPP_ENABLE_IO_URING to 0 leaves io_uring out, SappDiskUsageOptions::useIoUring is ignored then.
+#ifndef SAPP_ENABLE_IO_URING
+#define SAPP_ENABLE_IO_URING 1
+#endif
+#if SAPP_ENABLE_IO_URING && __has_include( <linux/io_uring.h> )
+#include <linux/io_uring.h>
+#define SAPP_HAS_IO_URING 1
+#endif
+#endif
 #define CORRECT_PATH_SEPARATOR     '/'
 #define INCORRECT_PATH_SEPARATOR '\\'
 #endif
@@ -33,562 +78,6714 @@
 
 #define SAPP_MAX_PATH 4096
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define SAPP_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
 typedef unsigned int AppId_t, uint32;
 
 namespace fs = std::filesystem;
 
-class SteamAppPathProvider;
-
-class ISteamSearchProvider
+// Read-only view of a whole file. Small files are read straight into an inline buffer,
+// anything bigger is mapped, so handing the contents to a parser never touches the heap.
+// The view is only valid while the SappMappedFile is alive.
+class SappMappedFile
 {
+public:
+    static constexpr std::size_t smallFileLimit = SAPP_MAX_PATH;
 
-protected:
-    std::unordered_set<AppId_t> sourceGames;
-    std::unordered_set<AppId_t> source2Games;
-    bool precacheSourceGames = false;
-    bool precacheSource2Games = false;
+    SappMappedFile() = default;
+
+    explicit SappMappedFile( const std::string &path )
+    {
+        Open( path );
+    }
 
-    static auto SappFileHelper(std::string_view path ) -> std::string
+    ~SappMappedFile()
     {
-        constexpr auto read_size = std::size_t( SAPP_MAX_PATH );
-        auto stream = std::ifstream( path.data(), std::ios::binary );
-        stream.exceptions( std::ios_base::badbit );
+        Close();
+    }
+
+    SappMappedFile( const SappMappedFile & ) = delete;
+    SappMappedFile &operator=( const SappMappedFile & ) = delete;
+
+    SappMappedFile( SappMappedFile &&other ) noexcept
+    {
+        TakeFrom( other );
+    }
+
+    SappMappedFile &operator=( SappMappedFile &&other ) noexcept
+    {
+        if ( &other == this )
+            return *this;
+        Close();
+        TakeFrom( other );
+        return *this;
+    }
+
+    bool Open( const std::string &path )
+    {
+        Close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+        if ( file == INVALID_HANDLE_VALUE )
+            return false;
 
-        auto out = std::string();
-        auto buf = std::string( read_size, '\0' );
-        while ( stream.read( &buf[0], read_size ) )
+        LARGE_INTEGER fileSize;
+        if ( !GetFileSizeEx( file, &fileSize ) )
         {
-            out.append( buf, 0, stream.gcount() );
+            CloseHandle( file );
+            return false;
         }
-        out.append( buf, 0, stream.gcount() );
-        return out;
+        const auto length = static_cast<std::size_t>( fileSize.QuadPart );
+
+        if ( length <= smallFileLimit )
+        {
+            DWORD read = 0;
+            const bool ok = length == 0 || ReadFile( file, smallBuffer, static_cast<DWORD>( length ), &read, nullptr );
+            CloseHandle( file );
+            if ( !ok )
+                return false;
+            data = smallBuffer;
+            size = read;
+            opened = true;
+            return true;
+        }
+
+        HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        CloseHandle( file );
+        if ( !mapping )
+            return false;
+
+        auto view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+        CloseHandle( mapping );
+        if ( !view )
+            return false;
+
+        data = static_cast<const char *>( view );
+        size = length;
+        mapped = true;
+        opened = true;
+        return true;
+#else
+        const int fd = ::open( path.c_str(), O_RDONLY | O_CLOEXEC );
+        if ( fd < 0 )
+            return false;
+
+        struct stat st{};
+        if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) )
+        {
+            ::close( fd );
+            return false;
+        }
+        const auto length = static_cast<std::size_t>( st.st_size );
+
+        if ( length <= smallFileLimit )
+        {
+            std::size_t total = 0;
+            while ( total < length )
+            {
+                const auto got = pread( fd, smallBuffer + total, length - total, static_cast<off_t>( total ) );
+                if ( got < 0 && errno == EINTR )
+                    continue;
+                if ( got <= 0 )
+                    break;
+                total += static_cast<std::size_t>( got );
+            }
+            ::close( fd );
+            data = smallBuffer;
+            size = total;
+            opened = true;
+            return true;
+        }
+
+        void *view = mmap( nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+        ::close( fd );
+        if ( view == MAP_FAILED )
+            return false;
+        madvise( view, length, MADV_SEQUENTIAL );
+
+        data = static_cast<const char *>( view );
+        size = length;
+        mapped = true;
+        opened = true;
+        return true;
+#endif
+    }
+
+    void Close()
+    {
+        if ( mapped )
+        {
+#ifdef _WIN32
+            UnmapViewOfFile( data );
+#else
+            munmap( const_cast<char *>( data ), size );
+#endif
+        }
+        data = nullptr;
+        size = 0;
+        mapped = false;
+        opened = false;
+    }
+
+    [[nodiscard]] bool IsOpen() const
+    {
+        return opened;
+    }
+
+    [[nodiscard]] std::string_view View() const
+    {
+        return { data, size };
+    }
+
+private:
+    void TakeFrom( SappMappedFile &other )
+    {
+        if ( other.data == other.smallBuffer )
+        {
+            std::memcpy( smallBuffer, other.smallBuffer, other.size );
+            data = smallBuffer;
+        }
+        else
+        {
+            data = other.data;
+        }
+        size = other.size;
+        mapped = other.mapped;
+        opened = other.opened;
+        other.data = nullptr;
+        other.size = 0;
+        other.mapped = false;
+        other.opened = false;
     }
 
+    const char *data = nullptr;
+    std::size_t size = 0;
+    bool mapped = false;
+    bool opened = false;
+    char smallBuffer[smallFileLimit];
+};
+
+// Locates structural characters in a KeyValues buffer 16/32 bytes at a time.
+// Falls back to a plain loop where neither SSE2 nor AVX2 is available.
+struct SappCharScanner
+{
+    template<char... Chars>
+    [[nodiscard]] static const char *FindFirstOf( const char *begin, const char *end )
+    {
+        const char *p = begin;
+#if defined( __AVX2__ )
+        while ( end - p >= 32 )
+        {
+            const auto chunk = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( p ) );
+            __m256i hits = _mm256_setzero_si256();
+            ( ( hits = _mm256_or_si256( hits, _mm256_cmpeq_epi8( chunk, _mm256_set1_epi8( Chars ) ) ) ), ... );
+            const auto mask = static_cast<unsigned int>( _mm256_movemask_epi8( hits ) );
+            if ( mask )
+                return p + std::countr_zero( mask );
+            p += 32;
+        }
+#endif
+#if defined( SAPP_HAS_SSE2 )
+        while ( end - p >= 16 )
+        {
+            const auto chunk = _mm_loadu_si128( reinterpret_cast<const __m128i *>( p ) );
+            __m128i hits = _mm_setzero_si128();
+            ( ( hits = _mm_or_si128( hits, _mm_cmpeq_epi8( chunk, _mm_set1_epi8( Chars ) ) ) ), ... );
+            const auto mask = static_cast<unsigned int>( _mm_movemask_epi8( hits ) );
+            if ( mask )
+                return p + std::countr_zero( mask );
+            p += 16;
+        }
+#endif
+        for ( ; p < end; p++ )
+        {
+            if ( ( ( *p == Chars ) || ... ) )
+                return p;
+        }
+        return end;
+    }
+};
 
+// Single pass tokenizer for Valve's KeyValues text format (libraryfolders.vdf, *.acf, gameinfo.txt).
+// Tokens are views into the source buffer; quoted strings are returned without their quotes and
+// still escaped, use Unescape() when materializing them. [$CONDITIONAL] markers are skipped.
+class SappKeyValuesTokenizer
+{
 public:
-    virtual ~ISteamSearchProvider() = default;
+    enum class TokenType
+    {
+        String,
+        BlockBegin,
+        BlockEnd,
+        End,
+        Error
+    };
 
-    class Game
+    struct Token
     {
+        TokenType type;
+        std::string_view text;
+    };
 
-        friend SteamAppPathProvider; 
+    explicit SappKeyValuesTokenizer( std::string_view buffer )
+        : cursor( buffer.data() ), end( buffer.data() + buffer.size() )
+    {
+    }
 
-    public:
+    Token Next()
+    {
+        while ( true )
+        {
+            while ( cursor < end && IsSpace( *cursor ) )
+                cursor++;
+
+            if ( cursor >= end )
+                return { TokenType::End, {} };
+
+            if ( *cursor == '/' && cursor + 1 < end && cursor[1] == '/' )
+            {
+                SkipComment();
+                continue;
+            }
+
+            if ( *cursor == '[' )
+            {
+                const auto close = static_cast<const char *>( std::memchr( cursor, ']', end - cursor ) );
+                if ( !close )
+                    return Fail();
+                cursor = close + 1;
+                continue;
+            }
+            break;
+        }
+
+        switch ( *cursor )
+        {
+            case '{':
+                return { TokenType::BlockBegin, { cursor++, 1 } };
+            case '}':
+                return { TokenType::BlockEnd, { cursor++, 1 } };
+            case '"':
+            {
+                const char *start = ++cursor;
+                if ( !SkipQuotedBody() )
+                    return Fail();
+                return { TokenType::String, { start, static_cast<std::size_t>( cursor++ - start ) } };
+            }
+            default:
+            {
+                const char *start = cursor;
+                while ( cursor < end && !IsSpace( *cursor ) && *cursor != '"' && *cursor != '{' && *cursor != '}' )
+                    cursor++;
+                return { TokenType::String, { start, static_cast<std::size_t>( cursor - start ) } };
+            }
+        }
+    }
+
+    // Call after a BlockBegin token; moves past the matching BlockEnd without producing tokens.
+    bool SkipBlock()
+    {
+        int depth = 1;
+        while ( true )
+        {
+            cursor = SappCharScanner::FindFirstOf<'"', '{', '}', '/'>( cursor, end );
+            if ( cursor >= end )
+            {
+                Fail();
+                return false;
+            }
+
+            switch ( *cursor++ )
+            {
+                case '"':
+                    if ( !SkipQuotedBody() )
+                    {
+                        Fail();
+                        return false;
+                    }
+                    cursor++;
+                    break;
+                case '{':
+                    depth++;
+                    break;
+                case '}':
+                    if ( --depth == 0 )
+                        return true;
+                    break;
+                default:
+                    if ( cursor < end && *cursor == '/' )
+                    {
+                        cursor--;
+                        SkipComment();
+                    }
+                    break;
+            }
+        }
+    }
+
+    // Scans `rootKey { ... }` for the given keys and stores their values. Nested blocks are skipped
+    // wholesale and the scan stops as soon as every key has been seen. Returns the number of keys found.
+    static std::size_t FindValues( std::string_view buffer, std::string_view rootKey, std::span<const std::string_view> keys, std::span<std::string_view> values )
+    {
+        SappKeyValuesTokenizer tokenizer( buffer );
+        if ( !tokenizer.EnterBlock( rootKey ) )
+            return 0;
+
+        std::size_t found = 0;
+        while ( found < keys.size() )
+        {
+            const auto key = tokenizer.Next();
+            if ( key.type != TokenType::String )
+                break;
+
+            const auto value = tokenizer.Next();
+            if ( value.type == TokenType::BlockBegin )
+            {
+                if ( !tokenizer.SkipBlock() )
+                    break;
+                continue;
+            }
+            if ( value.type != TokenType::String )
+                break;
+
+            for ( std::size_t i = 0; i < keys.size(); i++ )
+            {
+                if ( values[i].data() == nullptr && KeyEquals( key.text, keys[i] ) )
+                {
+                    values[i] = value.text;
+                    found++;
+                    break;
+                }
+            }
+        }
+        return found;
+    }
+
+    // Consumes tokens up to and including the BlockBegin of the top level key `rootKey`.
+    bool EnterBlock( std::string_view rootKey )
+    {
+        while ( true )
+        {
+            const auto key = Next();
+            if ( key.type != TokenType::String )
+                return false;
+
+            const auto value = Next();
+            if ( value.type == TokenType::BlockBegin )
+            {
+                if ( KeyEquals( key.text, rootKey ) )
+                    return true;
+                if ( !SkipBlock() )
+                    return false;
+            }
+            else if ( value.type != TokenType::String )
+            {
+                return false;
+            }
+        }
+    }
+
+    // KeyValues keys are case-insensitive.
+    [[nodiscard]] static bool KeyEquals( std::string_view a, std::string_view b )
+    {
+        if ( a.size() != b.size() )
+            return false;
+        for ( std::size_t i = 0; i < a.size(); i++ )
+        {
+            if ( ToLower( a[i] ) != ToLower( b[i] ) )
+                return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] static constexpr char ToLower( char c )
+    {
+        return ( c >= 'A' && c <= 'Z' ) ? static_cast<char>( c + ( 'a' - 'A' ) ) : c;
+    }
+
+    [[nodiscard]] static std::string Unescape( std::string_view text )
+    {
+        std::string out;
+        AppendUnescaped( out, text );
+        return out;
+    }
+
+    static void AppendUnescaped( std::string &out, std::string_view text )
+    {
+        auto slash = text.find( '\\' );
+        if ( slash == std::string_view::npos )
+        {
+            out.append( text );
+            return;
+        }
+
+        out.reserve( out.size() + text.size() );
+        std::size_t last = 0;
+        while ( slash != std::string_view::npos && slash + 1 < text.size() )
+        {
+            out.append( text.substr( last, slash - last ) );
+            switch ( text[slash + 1] )
+            {
+                case 'n':
+                    out.push_back( '\n' );
+                    break;
+                case 't':
+                    out.push_back( '\t' );
+                    break;
+                default:
+                    out.push_back( text[slash + 1] );
+                    break;
+            }
+            last = slash + 2;
+            slash = text.find( '\\', last );
+        }
+        out.append( text.substr( last ) );
+    }
 
-        ~Game() = default;
+private:
+    static bool IsSpace( char c )
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
 
-        Game( const Game &game )
+    // Leaves the cursor on the closing quote.
+    bool SkipQuotedBody()
+    {
+        while ( true )
         {
-            gameName = game.gameName ;
-            library = game.library ;
-            installDir = game.installDir ;
-            icon = game.icon ;
-            appid = game.appid;
+            cursor = SappCharScanner::FindFirstOf<'"', '\\'>( cursor, end );
+            if ( cursor >= end )
+                return false;
+            if ( *cursor == '"' )
+                return true;
+            cursor += 2;
         }
+    }
+
+    void SkipComment()
+    {
+        const auto newline = static_cast<const char *>( std::memchr( cursor, '\n', end - cursor ) );
+        cursor = newline ? newline + 1 : end;
+    }
+
+    Token Fail()
+    {
+        cursor = end;
+        return { TokenType::Error, {} };
+    }
+
+    const char *cursor;
+    const char *end;
+};
+
+// Fields of an appmanifest_<appid>.acf that SappManifestParser can pick out.
+enum class SappManifestField : unsigned int
+{
+    AppId,
+    Name,
+    InstallDir,
+    SizeOnDisk,
+    BuildId,
+    LastUpdated,
+    StateFlags,
+};
+
+// Key and stored type of every field. Strings are views into the parsed file, still escaped.
+template<SappManifestField Field>
+struct SappManifestFieldTraits;
+
+template<>
+struct SappManifestFieldTraits<SappManifestField::AppId>
+{
+    static constexpr std::string_view key = "appid";
+    using Type = AppId_t;
+};
+
+template<>
+struct SappManifestFieldTraits<SappManifestField::Name>
+{
+    static constexpr std::string_view key = "name";
+    using Type = std::string_view;
+};
+
+template<>
+struct SappManifestFieldTraits<SappManifestField::InstallDir>
+{
+    static constexpr std::string_view key = "installdir";
+    using Type = std::string_view;
+};
+
+template<>
+struct SappManifestFieldTraits<SappManifestField::SizeOnDisk>
+{
+    static constexpr std::string_view key = "SizeOnDisk";
+    using Type = std::uint64_t;
+};
+
+template<>
+struct SappManifestFieldTraits<SappManifestField::BuildId>
+{
+    static constexpr std::string_view key = "buildid";
+    using Type = uint32;
+};
+
+// Unix time.
+template<>
+struct SappManifestFieldTraits<SappManifestField::LastUpdated>
+{
+    static constexpr std::string_view key = "LastUpdated";
+    using Type = std::uint64_t;
+};
+
+// 4 = fully installed, anything else means an update or download is in progress.
+template<>
+struct SappManifestFieldTraits<SappManifestField::StateFlags>
+{
+    static constexpr std::string_view key = "StateFlags";
+    using Type = uint32;
+};
+
+// Holds only the requested fields, e.g. SappManifestRecord<AppId, SizeOnDisk> is 16 bytes.
+template<SappManifestField... Fields>
+class SappManifestRecord
+{
+public:
+    static constexpr std::array<SappManifestField, sizeof...( Fields )> fields{ Fields... };
 
-        Game( Game &&game )
- noexcept         {
-            gameName = std::move( game.gameName );
-            library = std::move( game.library );
-            installDir = std::move( game.installDir );
-            icon = std::move( game.icon );
-            appid = game.appid;
+private:
+    static_assert( sizeof...( Fields ) > 0 && sizeof...( Fields ) <= 32 );
+    static_assert( []
+    {
+        for ( std::size_t i = 0; i < fields.size(); i++ )
+        {
+            for ( std::size_t j = i + 1; j < fields.size(); j++ )
+            {
+                if ( fields[i] == fields[j] )
+                    return false;
+            }
         }
+        return true;
+    }(), "every field can only be requested once" );
+
+public:
+    template<SappManifestField Field>
+    static constexpr bool Has = ( ( Field == Fields ) || ... );
+
+    // Position of Field in Fields.
+    template<SappManifestField Field>
+        requires Has<Field>
+    static constexpr std::size_t IndexOf = static_cast<std::size_t>( std::find( fields.begin(), fields.end(), Field ) - fields.begin() );
+
+    template<SappManifestField Field>
+        requires Has<Field>
+    [[nodiscard]] const auto &Get() const
+    {
+        return std::get<IndexOf<Field>>( values );
+    }
+
+    template<SappManifestField Field>
+        requires Has<Field>
+    auto &Get()
+    {
+        return std::get<IndexOf<Field>>( values );
+    }
+
+private:
+    std::tuple<typename SappManifestFieldTraits<Fields>::Type...> values{};
+};
+
+// Reads the requested fields of a manifest in a single pass. Keys are looked up in a perfect hash
+// table built at compile time, so every key of the file costs one hash and at most one comparison,
+// and the scan stops as soon as every field has been seen.
+template<SappManifestField... Fields>
+class SappManifestParser
+{
+public:
+    using Record = SappManifestRecord<Fields...>;
+
+    // Bit i of the result is set when Fields[i] was found and its value parsed.
+    template<SappManifestField Field>
+    static constexpr uint32 Bit = 1u << Record::template IndexOf<Field>;
+    static constexpr uint32 allFields = static_cast<uint32>( ( std::uint64_t( 1 ) << sizeof...( Fields ) ) - 1 );
+
+    static uint32 Parse( std::string_view file, Record &record )
+    {
+        SappKeyValuesTokenizer tokenizer( file );
+        if ( !tokenizer.EnterBlock( "AppState" ) )
+            return 0;
+
+        uint32 seen = 0;
+        uint32 parsed = 0;
+        while ( seen != allFields )
+        {
+            const auto key = tokenizer.Next();
+            if ( key.type != SappKeyValuesTokenizer::TokenType::String )
+                break;
+
+            const auto value = tokenizer.Next();
+            if ( value.type == SappKeyValuesTokenizer::TokenType::BlockBegin )
+            {
+                if ( !tokenizer.SkipBlock() )
+                    break;
+                continue;
+            }
+            if ( value.type != SappKeyValuesTokenizer::TokenType::String )
+                break;
+
+            const auto slot = table[Slot( key.text, seed )];
+            if ( slot == 0 || ( seen & ( 1u << ( slot - 1 ) ) ) || !SappKeyValuesTokenizer::KeyEquals( key.text, keys[slot - 1] ) )
+                continue;
+
+            seen |= 1u << ( slot - 1 );
+            if ( Assign( record, slot - 1, value.text, std::index_sequence_for<decltype( Fields )...>{} ) )
+                parsed |= 1u << ( slot - 1 );
+        }
+        return parsed;
+    }
+
+private:
+    static constexpr std::array<std::string_view, sizeof...( Fields )> keys{ SappManifestFieldTraits<Fields>::key... };
+    static constexpr std::size_t tableSize = std::bit_ceil( sizeof...( Fields ) * 2 );
+
+    // Length, first and last character, case-insensitive; enough to tell the manifest keys apart.
+    static constexpr std::size_t Slot( std::string_view key, uint32 hashSeed )
+    {
+        if ( key.empty() )
+            return 0;
+        const uint32 mixed = static_cast<uint32>( key.size() ) | static_cast<uint32>( static_cast<unsigned char>( key.front() ) | 0x20 ) << 8 |
+                             static_cast<uint32>( static_cast<unsigned char>( key.back() ) | 0x20 ) << 16;
+        // The top bits of the product depend on every bit of mixed, the low ones only on the low ones.
+        return ( mixed * ( hashSeed * 2 + 0x9E3779B1u ) ) >> ( 32 - std::countr_zero( tableSize ) );
+    }
+
+    // The first seed that puts every key into a slot of its own.
+    static constexpr uint32 seed = []
+    {
+        for ( uint32 candidate = 0; candidate < 0x10000; candidate++ )
+        {
+            std::array<bool, tableSize> used{};
+            bool collides = false;
+            for ( const auto key : keys )
+            {
+                auto &slot = used[Slot( key, candidate )];
+                collides |= slot;
+                slot = true;
+            }
+            if ( !collides )
+                return candidate;
+        }
+        return 0xFFFFFFFFu;
+    }();
+    static_assert( seed != 0xFFFFFFFFu, "no perfect hash for these fields" );
+
+    // Field index + 1 per slot, 0 = no field hashes there.
+    static constexpr std::array<unsigned char, tableSize> table = []
+    {
+        std::array<unsigned char, tableSize> slots{};
+        for ( std::size_t i = 0; i < keys.size(); i++ )
+            slots[Slot( keys[i], seed )] = static_cast<unsigned char>( i + 1 );
+        return slots;
+    }();
+
+    template<std::size_t... Index>
+    static bool Assign( Record &record, std::size_t field, std::string_view text, std::index_sequence<Index...> )
+    {
+        bool parsed = false;
+        ( ( Index == field && ( parsed = AssignValue( record.template Get<Record::fields[Index]>(), text ) ) ), ... );
+        return parsed;
+    }
+
+    static bool AssignValue( std::string_view &out, std::string_view text )
+    {
+        out = text;
+        return true;
+    }
+
+    template<typename Number>
+    static bool AssignValue( Number &out, std::string_view text )
+    {
+        const auto result = std::from_chars( text.data(), text.data() + text.size(), out );
+        return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+    }
+};
+
+// Spreads `count` independent tasks over a fixed set of threads. Every worker starts with an
+// equal contiguous slice of the index range and, once its own slice is drained, steals half of
+// the remaining slice of another worker, so slow tasks (cold disks, network mounts) don't leave
+// the other workers idle.
+class SappWorkStealingPool
+{
+public:
+    [[nodiscard]] static unsigned int ResolveWorkerCount( unsigned int requested )
+    {
+        if ( requested != 0 )
+            return requested;
+        return std::max( 1u, std::thread::hardware_concurrency() );
+    }
+
+    // task( index, workerIndex ) is called exactly once for every index in [0, count).
+    template<typename Task>
+    static void Run( std::size_t count, unsigned int workerCount, Task &&task )
+    {
+        workerCount = static_cast<unsigned int>( std::min<std::size_t>( ResolveWorkerCount( workerCount ), count ) );
+        if ( workerCount <= 1 )
+        {
+            for ( std::size_t i = 0; i < count; i++ )
+                task( i, 0u );
+            return;
+        }
+
+        std::vector<Slice> slices( workerCount );
+        for ( unsigned int w = 0; w < workerCount; w++ )
+            slices[w].bounds.store( Pack( count * w / workerCount, count * ( w + 1 ) / workerCount ), std::memory_order_relaxed );
+
+        std::exception_ptr failure;
+        std::mutex failureLock;
+        auto worker = [&]( unsigned int self )
+        {
+            try
+            {
+                std::size_t index;
+                while ( Pop( slices[self], index ) || ( Steal( slices, self ) && Pop( slices[self], index ) ) )
+                    task( index, self );
+            }
+            catch ( ... )
+            {
+                std::scoped_lock lock( failureLock );
+                if ( !failure )
+                    failure = std::current_exception();
+            }
+        };
+
+        {
+            std::vector<std::jthread> threads;
+            threads.reserve( workerCount - 1 );
+            for ( unsigned int w = 1; w < workerCount; w++ )
+                threads.emplace_back( worker, w );
+            worker( 0 );
+        }
+
+        if ( failure )
+            std::rethrow_exception( failure );
+    }
+
+private:
+    // [begin, end) packed into one word so owner pops and steals are a single CAS.
+    struct alignas( 64 ) Slice
+    {
+        std::atomic<std::uint64_t> bounds{ 0 };
+    };
+
+    static std::uint64_t Pack( std::uint64_t begin, std::uint64_t end )
+    {
+        return begin | ( end << 32 );
+    }
+
+    static bool Pop( Slice &slice, std::size_t &index )
+    {
+        auto bounds = slice.bounds.load( std::memory_order_acquire );
+        while ( true )
+        {
+            const auto begin = bounds & 0xFFFFFFFFu;
+            const auto end = bounds >> 32;
+            if ( begin >= end )
+                return false;
+            if ( slice.bounds.compare_exchange_weak( bounds, Pack( begin + 1, end ), std::memory_order_acq_rel ) )
+            {
+                index = static_cast<std::size_t>( begin );
+                return true;
+            }
+        }
+    }
+
+    // Only called once the thief's own slice is empty, nobody else touches an empty slice.
+    static bool Steal( std::vector<Slice> &slices, unsigned int self )
+    {
+        const auto workerCount = static_cast<unsigned int>( slices.size() );
+        for ( unsigned int offset = 1; offset < workerCount; offset++ )
+        {
+            auto &victim = slices[( self + offset ) % workerCount];
+            auto bounds = victim.bounds.load( std::memory_order_acquire );
+            while ( true )
+            {
+                const auto begin = bounds & 0xFFFFFFFFu;
+                const auto end = bounds >> 32;
+                if ( begin >= end )
+                    break;
+
+                const auto split = end - std::max<std::uint64_t>( 1, ( end - begin ) / 2 );
+                if ( victim.bounds.compare_exchange_weak( bounds, Pack( begin, split ), std::memory_order_acq_rel ) )
+                {
+                    slices[self].bounds.store( Pack( split, end ), std::memory_order_release );
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+// Number of filesystem calls made while probing for gameinfo files. For the portable probe every
+// std::filesystem query is counted as one call, though most of them cost at least one stat.
+struct SappProbeCounters
+{
+    std::uint64_t opens = 0;
+    std::uint64_t directoryReads = 0;
+    std::uint64_t accessChecks = 0;
+    std::uint64_t stats = 0;
+
+    [[nodiscard]] std::uint64_t Total() const
+    {
+        return opens + directoryReads + accessChecks + stats;
+    }
+};
+
+#ifdef __linux__
+// A record of the buffer filled by the getdents64 syscall, which glibc doesn't declare.
+struct SappLinuxDirent64
+{
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+// Finds out whether an install folder holds a Source game (<dir>/gameinfo.txt) and/or a Source 2 game
+// (<dir>/gameinfo.gi or <dir>/<subdir>/gameinfo.gi), answering both in a single walk that stops as
+// soon as everything asked for is known. On Linux the walk opens each directory once and works
+// relative to its descriptor with getdents64/faccessat, using d_type to avoid stat calls.
+class SappEngineProbe
+{
+public:
+    enum Flags : std::uint8_t
+    {
+        Source = 1 << 0,
+        Source2 = 1 << 1,
+    };
+
+    static std::uint8_t Probe( const std::string &installDir, bool wantSource, bool wantSource2, SappProbeCounters *counters = nullptr )
+    {
+#ifdef __linux__
+        return ProbeNative( installDir, wantSource, wantSource2, counters );
+#else
+        return ProbePortable( installDir, wantSource, wantSource2, counters );
+#endif
+    }
+
+    static std::uint8_t ProbePortable( const std::string &installDir, bool wantSource, bool wantSource2, SappProbeCounters *counters = nullptr )
+    {
+        SappProbeCounters local;
+        auto &count = counters ? *counters : local;
+        const std::uint8_t wanted = ( wantSource ? Source : 0 ) | ( wantSource2 ? Source2 : 0 );
+        std::uint8_t flags = 0;
+        std::error_code ec;
+
+        count.opens++;
+        for ( auto const &dir_entry : std::filesystem::directory_iterator { installDir, std::filesystem::directory_options::skip_permission_denied, ec } )
+        {
+            count.directoryReads++;
+            count.stats++;
+            if ( !dir_entry.is_directory( ec ) )
+                continue;
+
+            if ( ( wanted & Source ) && !( flags & Source ) )
+            {
+                count.stats++;
+                if ( std::filesystem::exists( dir_entry.path() / "gameinfo.txt", ec ) )
+                    flags |= Source;
+            }
+
+            if ( ( wanted & Source2 ) && !( flags & Source2 ) )
+            {
+                count.stats++;
+                if ( std::filesystem::exists( dir_entry.path() / "gameinfo.gi", ec ) )
+                {
+                    flags |= Source2;
+                }
+                else
+                {
+                    count.opens++;
+                    for ( auto const &subdir_entry : std::filesystem::directory_iterator { dir_entry.path(), std::filesystem::directory_options::skip_permission_denied, ec } )
+                    {
+                        count.directoryReads++;
+                        count.stats += 2;
+                        if ( subdir_entry.is_directory( ec ) && std::filesystem::exists( subdir_entry.path() / "gameinfo.gi", ec ) )
+                        {
+                            flags |= Source2;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if ( flags == wanted )
+                break;
+        }
+        return flags;
+    }
+
+#ifdef __linux__
+    static std::uint8_t ProbeNative( const std::string &installDir, bool wantSource, bool wantSource2, SappProbeCounters *counters = nullptr )
+    {
+        SappProbeCounters local;
+        auto &count = counters ? *counters : local;
+        const std::uint8_t wanted = ( wantSource ? Source : 0 ) | ( wantSource2 ? Source2 : 0 );
+        std::uint8_t flags = 0;
+        if ( !wanted )
+            return flags;
+
+        count.opens++;
+        const int root = ::open( installDir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+        if ( root < 0 )
+            return flags;
+
+        ForEachDirectory( root, count, [&]( const char *name )
+        {
+            if ( ( wanted & Source ) && !( flags & Source ) && Accessible( root, name, "gameinfo.txt", count ) )
+                flags |= Source;
+
+            if ( ( wanted & Source2 ) && !( flags & Source2 ) )
+            {
+                if ( Accessible( root, name, "gameinfo.gi", count ) )
+                {
+                    flags |= Source2;
+                }
+                else
+                {
+                    count.opens++;
+                    const int sub = ::openat( root, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+                    if ( sub >= 0 )
+                    {
+                        ForEachDirectory( sub, count, [&]( const char *subName )
+                        {
+                            if ( Accessible( sub, subName, "gameinfo.gi", count ) )
+                                flags |= Source2;
+                            return !( flags & Source2 );
+                        } );
+                        ::close( sub );
+                    }
+                }
+            }
+            return flags != wanted;
+        } );
+
+        ::close( root );
+        return flags;
+    }
+
+private:
+    // Calls visit( name ) for every subdirectory of fd (following symlinks) until it returns false.
+    template<typename Visit>
+    static void ForEachDirectory( int fd, SappProbeCounters &count, Visit &&visit )
+    {
+        alignas( SappLinuxDirent64 ) char buffer[SAPP_MAX_PATH * 2];
+        while ( true )
+        {
+            count.directoryReads++;
+            const auto length = syscall( SYS_getdents64, fd, buffer, sizeof( buffer ) );
+            if ( length <= 0 )
+                return;
+
+            for ( long offset = 0; offset < length; )
+            {
+                const auto entry = reinterpret_cast<const SappLinuxDirent64 *>( buffer + offset );
+                offset += entry->d_reclen;
+
+                const char *name = entry->d_name;
+                if ( name[0] == '.' && ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) ) )
+                    continue;
+
+                bool isDirectory = entry->d_type == DT_DIR;
+                if ( entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK )
+                {
+                    count.stats++;
+                    struct stat st{};
+                    isDirectory = fstatat( fd, name, &st, 0 ) == 0 && S_ISDIR( st.st_mode );
+                }
+                if ( isDirectory && !visit( name ) )
+                    return;
+            }
+        }
+    }
+
+    static bool Accessible( int fd, const char *directory, const char *file, SappProbeCounters &count )
+    {
+        char relative[SAPP_MAX_PATH];
+        const auto written = std::snprintf( relative, sizeof( relative ), "%s/%s", directory, file );
+        if ( written < 0 || static_cast<std::size_t>( written ) >= sizeof( relative ) )
+            return false;
+        count.accessChecks++;
+        return faccessat( fd, relative, F_OK, 0 ) == 0;
+    }
+#endif
+};
+
+// Append-only string storage handed out as string_views. Strings are packed into large chunks
+// that never move, so the views stay valid for the lifetime of the arena (including across moves
+// of the arena itself). Intern() returns the same view for equal strings.
+class SappStringArena
+{
+public:
+    static constexpr std::size_t chunkSize = 64 * 1024;
+
+    std::string_view Store( std::string_view text )
+    {
+        if ( text.empty() )
+            return {};
+
+        if ( text.size() > remaining )
+        {
+            const auto size = std::max( chunkSize, text.size() );
+            chunks.push_back( std::make_unique_for_overwrite<char[]>( size ) );
+            cursor = chunks.back().get();
+            remaining = size;
+            reserved += size;
+        }
+
+        std::memcpy( cursor, text.data(), text.size() );
+        const std::string_view stored( cursor, text.size() );
+        cursor += text.size();
+        remaining -= text.size();
+        used += text.size();
+        return stored;
+    }
+
+    std::string_view Intern( std::string_view text )
+    {
+        const auto existing = interned.find( text );
+        if ( existing != interned.end() )
+            return *existing;
+        const auto stored = Store( text );
+        interned.insert( stored );
+        return stored;
+    }
+
+    [[nodiscard]] std::size_t BytesUsed() const
+    {
+        return used;
+    }
+
+    [[nodiscard]] std::size_t BytesReserved() const
+    {
+        return reserved;
+    }
+
+    // Notes stored bytes the owner no longer uses, so it can tell when a fresh arena pays off.
+    void Abandon( std::size_t bytes )
+    {
+        abandoned += bytes;
+    }
+
+    [[nodiscard]] std::size_t BytesAbandoned() const
+    {
+        return abandoned;
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::unordered_set<std::string_view> interned;
+    char *cursor = nullptr;
+    std::size_t remaining = 0;
+    std::size_t used = 0;
+    std::size_t reserved = 0;
+    std::size_t abandoned = 0;
+};
+
+// Storage for SappChunkedArray and SappSortedChunks: blocks shared between copies of a container.
+// A block is only written in place by the container that made it, and only until it is copied;
+// from then on either side gets its own block on its first write. Copying a container and
+// changing a few elements thus costs the list of blocks plus one block per change, however many
+// elements it holds.
+template<typename T>
+class SappSharedChunks
+{
+public:
+    SappSharedChunks() = default;
+
+    SappSharedChunks( const SappSharedChunks &other )
+        : chunks( other.chunks )
+    {
+        other.owner.store( NewOwner(), std::memory_order_relaxed );
+    }
+
+    SappSharedChunks &operator=( const SappSharedChunks &other )
+    {
+        chunks = other.chunks;
+        owner.store( NewOwner(), std::memory_order_relaxed );
+        other.owner.store( NewOwner(), std::memory_order_relaxed );
+        return *this;
+    }
+
+    SappSharedChunks( SappSharedChunks &&other ) noexcept
+        : chunks( std::move( other.chunks ) ), owner( other.owner.load( std::memory_order_relaxed ) )
+    {
+        other.owner.store( NewOwner(), std::memory_order_relaxed );
+    }
+
+    SappSharedChunks &operator=( SappSharedChunks &&other ) noexcept
+    {
+        chunks = std::move( other.chunks );
+        owner.store( other.owner.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        other.owner.store( NewOwner(), std::memory_order_relaxed );
+        return *this;
+    }
+
+    [[nodiscard]] std::size_t Count() const
+    {
+        return chunks.size();
+    }
+
+    [[nodiscard]] const std::vector<T> &operator[]( std::size_t chunk ) const
+    {
+        return chunks[chunk]->items;
+    }
+
+    // The block to write to, copied first unless this container made it. A copy has room for at
+    // least capacity elements.
+    std::vector<T> &Own( std::size_t chunk, std::size_t capacity = 0 )
+    {
+        auto &shared = chunks[chunk];
+        const auto current = owner.load( std::memory_order_relaxed );
+        if ( shared->owner != current )
+        {
+            std::vector<T> items;
+            items.reserve( std::max( capacity, shared->items.size() ) );
+            items.insert( items.end(), shared->items.begin(), shared->items.end() );
+            shared = std::make_shared<Chunk>( current, std::move( items ) );
+        }
+        return shared->items;
+    }
+
+    std::vector<T> &Insert( std::size_t chunk, std::vector<T> items = {} )
+    {
+        return ( *chunks.insert( chunks.begin() + static_cast<std::ptrdiff_t>( chunk ), std::make_shared<Chunk>( owner.load( std::memory_order_relaxed ), std::move( items ) ) ) )->items;
+    }
+
+    void Erase( std::size_t chunk )
+    {
+        chunks.erase( chunks.begin() + static_cast<std::ptrdiff_t>( chunk ) );
+    }
+
+    void Clear()
+    {
+        chunks.clear();
+    }
+
+    [[nodiscard]] std::size_t CapacityBytes() const
+    {
+        std::size_t bytes = chunks.capacity() * sizeof( std::shared_ptr<Chunk> );
+        for ( const auto &chunk : chunks )
+            bytes += sizeof( Chunk ) + chunk->items.capacity() * sizeof( T );
+        return bytes;
+    }
+
+private:
+    struct Chunk
+    {
+        Chunk( std::uint64_t vOwner, std::vector<T> vItems )
+            : owner( vOwner ), items( std::move( vItems ) )
+        {
+        }
+
+        std::uint64_t owner;
+        std::vector<T> items;
+    };
+
+    static std::uint64_t NewOwner()
+    {
+        static std::atomic<std::uint64_t> owners{ 0 };
+        return owners.fetch_add( 1, std::memory_order_relaxed ) + 1;
+    }
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    // Tells the blocks this container may write in place from those it shares, see Own(). Copying
+    // from a const container renews it, so it's atomic.
+    mutable std::atomic<std::uint64_t> owner{ NewOwner() };
+};
+
+// An indexable array in fixed blocks of SappSharedChunks, for the per-game lists of a snapshot
+// that the next snapshot mostly shares. Every block has room for chunkSize elements, so the
+// element pointers kept next to them stay valid until the block is replaced.
+template<typename T>
+class SappChunkedArray
+{
+public:
+    static constexpr std::size_t chunkShift = 8;
+    static constexpr std::size_t chunkSize = std::size_t( 1 ) << chunkShift;
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return count;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return count == 0;
+    }
+
+    [[nodiscard]] const T &operator[]( std::size_t index ) const
+    {
+        return blocks[index >> chunkShift][index & ( chunkSize - 1 )];
+    }
+
+    T &Mutable( std::size_t index )
+    {
+        return Own( index >> chunkShift )[index & ( chunkSize - 1 )];
+    }
+
+    void PushBack( const T &value )
+    {
+        if ( ( count & ( chunkSize - 1 ) ) == 0 )
+        {
+            chunks.Insert( chunks.Count() ).reserve( chunkSize );
+            blocks.push_back( nullptr );
+        }
+        Own( chunks.Count() - 1 ).push_back( value );
+        count++;
+    }
+
+    void PopBack()
+    {
+        count--;
+        if ( ( count & ( chunkSize - 1 ) ) == 0 )
+        {
+            chunks.Erase( chunks.Count() - 1 );
+            blocks.pop_back();
+        }
+        else
+            Own( chunks.Count() - 1 ).pop_back();
+    }
+
+    void Assign( std::size_t size, const T &value )
+    {
+        Clear();
+        for ( std::size_t first = 0; first < size; first += chunkSize )
+        {
+            auto &items = chunks.Insert( chunks.Count() );
+            items.reserve( chunkSize );
+            items.assign( std::min( chunkSize, size - first ), value );
+            blocks.push_back( items.data() );
+        }
+        count = size;
+    }
+
+    void Clear()
+    {
+        chunks.Clear();
+        blocks.clear();
+        count = 0;
+    }
+
+    // Calls visit( std::span<const T> ) for every block in order.
+    template<typename Visit>
+    void ForEachChunk( Visit &&visit ) const
+    {
+        for ( std::size_t chunk = 0; chunk < chunks.Count(); chunk++ )
+            visit( std::span<const T>( chunks[chunk] ) );
+    }
+
+    [[nodiscard]] std::size_t CapacityBytes() const
+    {
+        return chunks.CapacityBytes() + blocks.capacity() * sizeof( const T * );
+    }
+
+private:
+    std::vector<T> &Own( std::size_t chunk )
+    {
+        auto &items = chunks.Own( chunk, chunkSize );
+        blocks[chunk] = items.data();
+        return items;
+    }
+
+    SappSharedChunks<T> chunks;
+    // chunks[i].data(), saving a load per lookup.
+    std::vector<const T *> blocks;
+    std::size_t count = 0;
+};
+
+// A sorted multiset in blocks of SappSharedChunks, of up to maxChunk elements each. Inserting or
+// erasing binary searches the blocks and then the one block it lands in, which is the only one
+// copied. Less orders the elements; searches take their own comparison against a key.
+template<typename T, typename Less>
+class SappSortedChunks
+{
+public:
+    static constexpr std::size_t maxChunk = 512;
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        Iterator() = default;
+
+        Iterator( const SappSharedChunks<T> *vChunks, std::size_t vChunk, std::size_t vPosition )
+            : chunks( vChunks ), chunk( vChunk ), position( vPosition )
+        {
+        }
+
+        const T &operator*() const
+        {
+            return ( *chunks )[chunk][position];
+        }
+
+        const T *operator->() const
+        {
+            return &**this;
+        }
+
+        Iterator &operator++()
+        {
+            if ( ++position == ( *chunks )[chunk].size() )
+            {
+                chunk++;
+                position = 0;
+            }
+            return *this;
+        }
+
+        Iterator &operator--()
+        {
+            if ( position == 0 )
+                position = ( *chunks )[--chunk].size();
+            position--;
+            return *this;
+        }
+
+        bool operator==( const Iterator &other ) const
+        {
+            return chunk == other.chunk && position == other.position;
+        }
+
+        // The number of elements from this one to last, which must not come before it. Costs a step
+        // per block in between.
+        [[nodiscard]] std::size_t DistanceTo( const Iterator &last ) const
+        {
+            std::size_t distance = last.position;
+            for ( auto between = chunk; between < last.chunk; between++ )
+                distance += ( *chunks )[between].size();
+            return distance - position;
+        }
+
+    private:
+        const SappSharedChunks<T> *chunks = nullptr;
+        std::size_t chunk = 0;
+        std::size_t position = 0;
+    };
+
+    [[nodiscard]] Iterator begin() const
+    {
+        return Iterator( &chunks, 0, 0 );
+    }
+
+    [[nodiscard]] Iterator end() const
+    {
+        return Iterator( &chunks, chunks.Count(), 0 );
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+        return count;
+    }
+
+    // The first element e with !comp( e, key ).
+    template<typename Key, typename Compare>
+    [[nodiscard]] Iterator LowerBound( const Key &key, Compare &&comp ) const
+    {
+        const auto chunk = FirstChunk( [&]( const T &last ) { return !comp( last, key ); } );
+        if ( chunk == chunks.Count() )
+            return end();
+        const auto &items = chunks[chunk];
+        return Iterator( &chunks, chunk, static_cast<std::size_t>( std::lower_bound( items.begin(), items.end(), key, comp ) - items.begin() ) );
+    }
+
+    // The first element e with comp( key, e ).
+    template<typename Key, typename Compare>
+    [[nodiscard]] Iterator UpperBound( const Key &key, Compare &&comp ) const
+    {
+        const auto chunk = FirstChunk( [&]( const T &last ) { return comp( key, last ); } );
+        if ( chunk == chunks.Count() )
+            return end();
+        const auto &items = chunks[chunk];
+        return Iterator( &chunks, chunk, static_cast<std::size_t>( std::upper_bound( items.begin(), items.end(), key, comp ) - items.begin() ) );
+    }
+
+    void Insert( const T &value )
+    {
+        auto chunk = FirstChunk( [&]( const T &last ) { return Less()( value, last ); } );
+        if ( chunk == chunks.Count() )
+        {
+            if ( chunk == 0 || chunks[chunk - 1].size() >= maxChunk )
+                chunks.Insert( chunk );
+            else
+                chunk--;
+        }
+
+        auto &items = chunks.Own( chunk );
+        items.insert( std::upper_bound( items.begin(), items.end(), value, Less() ), value );
+        count++;
+        if ( items.size() > maxChunk )
+        {
+            const auto half = items.begin() + static_cast<std::ptrdiff_t>( items.size() / 2 );
+            std::vector<T> upper( half, items.end() );
+            items.erase( half, items.end() );
+            chunks.Insert( chunk + 1, std::move( upper ) );
+        }
+    }
+
+    // Erases one element equal to value. Returns false if there is none.
+    bool Erase( const T &value )
+    {
+        const auto chunk = FirstChunk( [&]( const T &last ) { return !Less()( last, value ); } );
+        if ( chunk == chunks.Count() )
+            return false;
+        const auto &shared = chunks[chunk];
+        const auto found = std::lower_bound( shared.begin(), shared.end(), value, Less() );
+        if ( found == shared.end() || Less()( value, *found ) )
+            return false;
+
+        const auto position = found - shared.begin();
+        auto &items = chunks.Own( chunk );
+        items.erase( items.begin() + position );
+        count--;
+        if ( items.empty() )
+            chunks.Erase( chunk );
+        else if ( chunk + 1 < chunks.Count() && items.size() + chunks[chunk + 1].size() <= maxChunk / 2 )
+        {
+            // Keeps erasures from leaving many small blocks behind.
+            const auto &next = chunks[chunk + 1];
+            items.insert( items.end(), next.begin(), next.end() );
+            chunks.Erase( chunk + 1 );
+        }
+        return true;
+    }
+
+    // Replaces the contents with sorted, which has to be ordered by Less.
+    void Assign( std::span<const T> sorted )
+    {
+        chunks.Clear();
+        for ( std::size_t first = 0; first < sorted.size(); first += maxChunk / 2 )
+        {
+            const auto part = sorted.subspan( first, std::min( maxChunk / 2, sorted.size() - first ) );
+            chunks.Insert( chunks.Count(), std::vector<T>( part.begin(), part.end() ) );
+        }
+        count = sorted.size();
+    }
+
+    [[nodiscard]] std::size_t CapacityBytes() const
+    {
+        return chunks.CapacityBytes();
+    }
+
+private:
+    // The first block whose last element satisfies pred, which has to be false then true over the blocks.
+    template<typename Pred>
+    [[nodiscard]] std::size_t FirstChunk( Pred &&pred ) const
+    {
+        std::size_t low = 0;
+        std::size_t high = chunks.Count();
+        while ( low < high )
+        {
+            const auto middle = low + ( high - low ) / 2;
+            if ( pred( chunks[middle].back() ) )
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        return low;
+    }
+
+    SappSharedChunks<T> chunks;
+    std::size_t count = 0;
+};
+
+// Scan instrumentation. Collection is opt-in per scan (SappScanOptions::stats / trace); defining
+// SAPP_ENABLE_SCAN_STATS to 0 removes every timer and counter from the scan at compile time.
+#ifndef SAPP_ENABLE_SCAN_STATS
+#define SAPP_ENABLE_SCAN_STATS 1
+#endif
+
+#if SAPP_ENABLE_SCAN_STATS
+#define SAPP_SCAN_STAT( statement ) statement
+#else
+#define SAPP_SCAN_STAT( statement )
+#endif
+
+enum class SappScanPhase : unsigned int
+{
+    SteamRoot,
+    LibraryFolders,
+    ManifestListing,
+    ManifestRead,
+    ManifestParse,
+    EngineProbe,
+    Count
+};
+
+struct SappScanCounters
+{
+    // For the manifest phases of a parallel scan this is summed over all workers.
+    std::chrono::nanoseconds wallTime{ 0 };
+    std::uint64_t filesOpened = 0;
+    std::uint64_t bytesRead = 0;
+    std::uint64_t directoryEntries = 0;
+    // stat, exists and access checks.
+    std::uint64_t statCalls = 0;
+
+    SappScanCounters &operator+=( const SappScanCounters &other )
+    {
+        wallTime += other.wallTime;
+        filesOpened += other.filesOpened;
+        bytesRead += other.bytesRead;
+        directoryEntries += other.directoryEntries;
+        statCalls += other.statCalls;
+        return *this;
+    }
+
+    void Add( const SappProbeCounters &probe )
+    {
+        filesOpened += probe.opens;
+        directoryEntries += probe.directoryReads;
+        statCalls += probe.accessChecks + probe.stats;
+    }
+};
+
+struct SappScanStats
+{
+    using Phases = std::array<SappScanCounters, static_cast<std::size_t>( SappScanPhase::Count )>;
+
+    struct Library
+    {
+        std::string path;
+        uint32 manifests = 0;
+        Phases phases{};
+    };
+
+    std::chrono::nanoseconds totalTime{ 0 };
+    Phases phases{};
+    std::vector<Library> libraries;
+
+    [[nodiscard]] const SappScanCounters &operator[]( SappScanPhase phase ) const
+    {
+        return phases[static_cast<std::size_t>( phase )];
+    }
+
+    [[nodiscard]] static const char *PhaseName( SappScanPhase phase )
+    {
+        switch ( phase )
+        {
+            case SappScanPhase::SteamRoot:
+                return "steam root";
+            case SappScanPhase::LibraryFolders:
+                return "libraryfolders.vdf";
+            case SappScanPhase::ManifestListing:
+                return "manifest listing";
+            case SappScanPhase::ManifestRead:
+                return "manifest read";
+            case SappScanPhase::ManifestParse:
+                return "manifest parse";
+            case SappScanPhase::EngineProbe:
+                return "engine probe";
+            default:
+                return "?";
+        }
+    }
+
+    // Plain text summary, meant to be pasted into bug reports.
+    [[nodiscard]] std::string ToString() const
+    {
+        std::string out = "total: " + FormatTime( totalTime ) + "\n";
+        AppendPhases( out, phases, "" );
+        for ( const auto &library : libraries )
+        {
+            out += library.path + " (" + std::to_string( library.manifests ) + " manifests)\n";
+            AppendPhases( out, library.phases, "  " );
+        }
+        return out;
+    }
+
+private:
+    static std::string FormatTime( std::chrono::nanoseconds time )
+    {
+        return std::to_string( std::chrono::duration<double, std::milli>( time ).count() ) + " ms";
+    }
+
+    static void AppendPhases( std::string &out, const Phases &phases, const char *indent )
+    {
+        for ( std::size_t i = 0; i < phases.size(); i++ )
+        {
+            const auto &counters = phases[i];
+            if ( counters.wallTime.count() == 0 && counters.filesOpened == 0 && counters.directoryEntries == 0 && counters.statCalls == 0 )
+                continue;
+            out += indent;
+            out += PhaseName( static_cast<SappScanPhase>( i ) );
+            out += ": " + FormatTime( counters.wallTime ) + ", " + std::to_string( counters.filesOpened ) + " files opened, " + std::to_string( counters.bytesRead ) + " bytes read, " +
+                   std::to_string( counters.directoryEntries ) + " directory entries, " + std::to_string( counters.statCalls ) + " stat calls\n";
+        }
+    }
+};
+
+struct SappTraceEvent
+{
+    SappScanPhase phase;
+    bool begin;
+    // The file or directory the phase works on, empty for whole-scan phases.
+    std::string_view subject;
+};
+
+// Called from the scanning threads, so it must be thread-safe when parallelScan is on.
+using SappTraceCallback = std::function<void( const SappTraceEvent & )>;
+
+// Adds the time until it goes out of scope to `counters` and emits begin/end trace events.
+class SappScanTimer
+{
+public:
+#if SAPP_ENABLE_SCAN_STATS
+    SappScanTimer( SappScanCounters *vCounters, SappScanPhase vPhase, const SappTraceCallback *vTrace, std::string_view vSubject = {} )
+        : counters( vCounters ), trace( vTrace && *vTrace ? vTrace : nullptr ), phase( vPhase ), subject( vSubject )
+    {
+        if ( counters )
+            start = std::chrono::steady_clock::now();
+        if ( trace )
+            ( *trace )( { phase, true, subject } );
+    }
+
+    ~SappScanTimer()
+    {
+        if ( counters )
+            counters->wallTime += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start );
+        if ( trace )
+            ( *trace )( { phase, false, subject } );
+    }
+
+private:
+    SappScanCounters *counters;
+    const SappTraceCallback *trace;
+    SappScanPhase phase;
+    std::string_view subject;
+    std::chrono::steady_clock::time_point start;
+#else
+    template<typename... Args>
+    constexpr explicit SappScanTimer( Args &&... )
+    {
+    }
+#endif
+
+public:
+    SappScanTimer( const SappScanTimer & ) = delete;
+    SappScanTimer &operator=( const SappScanTimer & ) = delete;
+};
+
+struct SappScanOptions
+{
+    bool precacheSourceGames = false;
+    bool precacheSource2Games = false;
+    // Reads and classifies manifests from all libraries on a thread pool. The resulting
+    // game list is identical to (and in the same order as) a serial scan.
+    bool parallelScan = false;
+    // 0 uses one worker per hardware thread.
+    unsigned int workerCount = 0;
+    // Only used for the engines that aren't precached: classify each app the first time it is asked
+    // about and remember the answer, instead of walking its install folder on every call.
+    bool lazyEngineDetection = false;
+    // Keeps an inotify watch on libraryfolders.vdf and every steamapps directory, see PollChanges().
+    bool watch = false;
+    // Filled with per-phase and per-library timings and I/O counters of the scan.
+    SappScanStats *stats = nullptr;
+    // Receives begin/end events for every scan phase.
+    SappTraceCallback trace{};
+    // When set, scan results are stored in this file and reused by later constructions for
+    // every library and manifest whose modification time and size haven't changed.
+    std::string cacheFile{};
+    // When set, every snapshot the provider publishes is also written to this file for
+    // SappSharedSnapshot readers in other processes, see SappSharedSnapshot::DefaultPath(). The
+    // file is rewritten in full, so with it every change costs a pass over all games.
+    std::string sharedSnapshotFile{};
+};
+
+constexpr AppId_t k_uAppIdInvalid = 0x0;
+
+// Flat open-addressing map from appid to a position in the game list. Steam never hands out
+// appid 0, so it doubles as the empty slot marker. Kept at most half full, a lookup is
+// usually one block and one cache line. The slots are a SappChunkedArray, so a copy that only
+// changes a few apps shares all the other blocks with the original.
+class SappAppIdIndex
+{
+public:
+    static constexpr uint32 npos = 0xFFFFFFFFu;
+
+    void Reset( std::size_t count )
+    {
+        std::size_t capacity = 16;
+        while ( capacity < count * 2 )
+            capacity <<= 1;
+        entries.Assign( capacity, Entry{ k_uAppIdInvalid, npos } );
+        mask = capacity - 1;
+        shift = static_cast<unsigned int>( 32 - std::countr_zero( capacity ) );
+        used = 0;
+    }
+
+    // Keeps the first index seen for an appid, matching a front to back search of the list.
+    void Insert( AppId_t appid, uint32 index )
+    {
+        if ( appid == k_uAppIdInvalid )
+            return;
+        if ( ( used + 1 ) * 2 > entries.size() )
+            Grow();
+        for ( auto slot = Slot( appid );; slot = ( slot + 1 ) & mask )
+        {
+            const auto &entry = entries[slot];
+            if ( entry.appid == appid )
+                return;
+            if ( entry.appid == k_uAppIdInvalid )
+            {
+                entries.Mutable( slot ) = Entry{ appid, index };
+                used++;
+                return;
+            }
+        }
+    }
+
+    // Points an existing appid at a new position, or inserts it.
+    void Assign( AppId_t appid, uint32 index )
+    {
+        const auto slot = FindSlot( appid );
+        if ( slot != npos )
+            entries.Mutable( slot ).index = index;
+        else
+            Insert( appid, index );
+    }
+
+    void Erase( AppId_t appid )
+    {
+        auto hole = FindSlot( appid );
+        if ( hole == npos )
+            return;
+
+        // Backward shift deletion keeps every remaining probe chain intact without tombstones.
+        for ( auto slot = ( hole + 1 ) & mask; entries[slot].appid != k_uAppIdInvalid; slot = ( slot + 1 ) & mask )
+        {
+            const auto home = Slot( entries[slot].appid );
+            if ( ( ( slot - home ) & mask ) >= ( ( slot - hole ) & mask ) )
+            {
+                entries.Mutable( hole ) = entries[slot];
+                hole = slot;
+            }
+        }
+        entries.Mutable( hole ) = Entry{ k_uAppIdInvalid, npos };
+        used--;
+    }
+
+    [[nodiscard]] uint32 Find( AppId_t appid ) const
+    {
+        const auto slot = FindSlot( appid );
+        return slot == npos ? npos : entries[slot].index;
+    }
+
+    // A byte of per-app state that travels with the appid through Assign/Erase/growth and may be
+    // updated concurrently by const readers. Starts at 0. Returns nullptr if the appid isn't present.
+    // Copies share what readers of either one find out about apps neither of them changed.
+    [[nodiscard]] std::atomic<std::uint8_t> *EngineState( AppId_t appid ) const
+    {
+        const auto slot = FindSlot( appid );
+        return slot == npos ? nullptr : &entries[slot].state;
+    }
+
+    // Back to 0, in this copy only; for when the app changed.
+    void ResetEngineState( AppId_t appid )
+    {
+        const auto slot = FindSlot( appid );
+        if ( slot != npos )
+            entries.Mutable( slot ).state.store( 0, std::memory_order_relaxed );
+    }
+
+    // A byte of per-app flags only the owner sets, travelling with the appid like EngineState().
+    // 0 when the appid isn't present.
+    [[nodiscard]] std::uint8_t Flags( AppId_t appid ) const
+    {
+        const auto slot = FindSlot( appid );
+        return slot == npos ? 0 : entries[slot].flags;
+    }
+
+    void SetFlags( AppId_t appid, std::uint8_t flags )
+    {
+        const auto slot = FindSlot( appid );
+        if ( slot != npos && entries[slot].flags != flags )
+            entries.Mutable( slot ).flags = flags;
+    }
+
+private:
+    struct Entry
+    {
+        Entry( AppId_t vAppid = k_uAppIdInvalid, uint32 vIndex = npos, std::uint8_t vState = 0, std::uint8_t vFlags = 0 )
+            : appid( vAppid ), index( vIndex ), state( vState ), flags( vFlags )
+        {
+        }
+
+        Entry( const Entry &entry )
+            : appid( entry.appid ), index( entry.index ), state( entry.state.load( std::memory_order_relaxed ) ), flags( entry.flags )
+        {
+        }
+
+        Entry &operator=( const Entry &entry )
+        {
+            appid = entry.appid;
+            index = entry.index;
+            state.store( entry.state.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+            flags = entry.flags;
+            return *this;
+        }
+
+        AppId_t appid;
+        uint32 index;
+        // Filled in lazily by const readers, see EngineState().
+        mutable std::atomic<std::uint8_t> state;
+        std::uint8_t flags;
+    };
+
+    // Fibonacci hashing, appids are handed out in blocks so the low bits alone cluster badly.
+    [[nodiscard]] std::size_t Slot( AppId_t appid ) const
+    {
+        return static_cast<std::size_t>( ( appid * 0x9E3779B1u ) >> shift ) & mask;
+    }
+
+    [[nodiscard]] std::size_t FindSlot( AppId_t appid ) const
+    {
+        if ( appid == k_uAppIdInvalid || entries.empty() )
+            return npos;
+        for ( auto slot = Slot( appid );; slot = ( slot + 1 ) & mask )
+        {
+            const auto &entry = entries[slot];
+            if ( entry.appid == appid )
+                return slot;
+            if ( entry.appid == k_uAppIdInvalid )
+                return npos;
+        }
+    }
+
+    void Grow()
+    {
+        const auto previous = std::move( entries );
+        Reset( std::max<std::size_t>( previous.size(), 8 ) );
+        for ( std::size_t i = 0; i < previous.size(); i++ )
+        {
+            const auto &entry = previous[i];
+            if ( entry.appid != k_uAppIdInvalid )
+            {
+                Insert( entry.appid, entry.index );
+                entries.Mutable( FindSlot( entry.appid ) ) = entry;
+            }
+        }
+    }
+
+    SappChunkedArray<Entry> entries;
+    std::size_t mask = 0;
+    std::size_t used = 0;
+    unsigned int shift = 32;
+};
+
+// Tells whether two paths lead to the same directory, e.g. a library listed by both a native and a
+// Flatpak Steam under different paths. Not filled in on Windows, where paths are compared instead.
+struct SappFileId
+{
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+
+    [[nodiscard]] bool Valid() const
+    {
+        return device != 0 || inode != 0;
+    }
+
+    bool operator==( const SappFileId & ) const = default;
+};
+
+// Modification time and size of a file or directory, used to tell whether cached scan results are still current.
+struct SappFileStamp
+{
+    std::int64_t mtime = -1;
+    std::uint64_t size = 0;
+
+    [[nodiscard]] bool Exists() const
+    {
+        return mtime != -1;
+    }
+
+    bool operator==( const SappFileStamp & ) const = default;
+
+    static SappFileStamp Of( const std::string &path, [[maybe_unused]] SappFileId *identity = nullptr )
+    {
+#ifdef _WIN32
+        std::error_code ec;
+        const auto time = fs::last_write_time( path, ec );
+        if ( ec )
+            return {};
+        const auto size = fs::is_regular_file( path, ec ) ? fs::file_size( path, ec ) : 0;
+        return { static_cast<std::int64_t>( time.time_since_epoch().count() ), ec ? 0 : static_cast<std::uint64_t>( size ) };
+#else
+        struct stat st{};
+        if ( ::stat( path.c_str(), &st ) != 0 )
+            return {};
+        if ( identity )
+            *identity = { static_cast<std::uint64_t>( st.st_dev ), static_cast<std::uint64_t>( st.st_ino ) };
+#ifdef __APPLE__
+        const auto &time = st.st_mtimespec;
+#else
+        const auto &time = st.st_mtim;
+#endif
+        return { static_cast<std::int64_t>( time.tv_sec ) * 1000000000ll + time.tv_nsec, static_cast<std::uint64_t>( st.st_size ) };
+#endif
+    }
+};
+
+// Replaces a file in one step: the contents go to a new file next to it, readable and writable by
+// the owner only, which is then renamed over it. Readers see the old file or the new one, never a
+// partial write, and a planted file or symlink at the temporary name is refused, not followed.
+class SappAtomicFile
+{
+public:
+    static bool Replace( const std::string &path, std::string_view contents )
+    {
+        const auto temporary = path + "." + std::to_string( ProcessId() ) + "." + std::to_string( std::chrono::steady_clock::now().time_since_epoch().count() ) + ".tmp";
+        if ( !WriteNew( temporary, contents ) )
+        {
+            std::error_code ec;
+            fs::remove( temporary, ec );
+            return false;
+        }
+
+        std::error_code ec;
+        fs::rename( temporary, path, ec );
+        if ( ec )
+            fs::remove( temporary, ec );
+        return !ec;
+    }
+
+private:
+    // Creates path, which must not exist yet.
+    static bool WriteNew( const std::string &path, std::string_view contents )
+    {
+#ifdef _WIN32
+        const auto file = CreateFileA( path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr );
+        if ( file == INVALID_HANDLE_VALUE )
+            return false;
+        std::size_t total = 0;
+        while ( total < contents.size() )
+        {
+            DWORD written = 0;
+            const auto chunk = static_cast<DWORD>( std::min<std::size_t>( contents.size() - total, 1u << 30 ) );
+            if ( !WriteFile( file, contents.data() + total, chunk, &written, nullptr ) || !written )
+                break;
+            total += written;
+        }
+        return CloseHandle( file ) && total == contents.size();
+#else
+        const int fd = ::open( path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600 );
+        if ( fd < 0 )
+            return false;
+        std::size_t total = 0;
+        while ( total < contents.size() )
+        {
+            const auto written = ::write( fd, contents.data() + total, contents.size() - total );
+            if ( written < 0 && errno == EINTR )
+                continue;
+            if ( written <= 0 )
+                break;
+            total += static_cast<std::size_t>( written );
+        }
+        return ::close( fd ) == 0 && total == contents.size();
+#endif
+    }
+
+    // Keeps two processes writing the same file at the same moment apart.
+    static unsigned long ProcessId()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<unsigned long>( getpid() );
+#endif
+    }
+};
+
+// On-disk snapshot of a previous scan: every Steam root with the stamp of its libraryfolders.vdf,
+// every library they list and every manifest in it, each with the stamp it had when it was read.
+// A stale library only has its directory re-listed and a stale manifest only itself reparsed,
+// everything else is taken from the snapshot.
+//
+// Layout (native endianness, everything 8-byte aligned):
+//   Header, Root[rootCount], Library[libraryCount], Manifest[manifestCount], char strings[stringBytes]
+// Strings are referenced by offset/length into the string table, so the file is used in place.
+class SappScanCache
+{
+public:
+    enum EngineFlags : uint32
+    {
+        SourceProbed = 1 << 0,
+        Source = 1 << 1,
+        Source2Probed = 1 << 2,
+        Source2 = 1 << 3,
+    };
+
+    struct CachedManifest
+    {
+        std::string_view file;
+        SappFileStamp stamp;
+        AppId_t appid;
+        std::string_view name;
+        std::string_view installDir;
+        uint32 engineFlags;
+    };
+
+    struct CachedRoot
+    {
+        std::string_view path;
+        SappFileStamp libraryFolders;
+    };
+
+    struct CachedLibrary
+    {
+        // The library's steamapps directory.
+        std::string_view path;
+        // Index of the first root listing it.
+        uint32 root;
+        SappFileStamp stamp;
+        // Sorted by file name.
+        std::span<const CachedManifest> manifests;
+    };
+
+    bool Load( const std::string &path )
+    {
+        roots.clear();
+        libraries.clear();
+        manifests.clear();
+        if ( !file.Open( path ) )
+            return false;
+
+        const auto data = file.View();
+        Header header{};
+        if ( data.size() < sizeof( header ) )
+            return false;
+        std::memcpy( &header, data.data(), sizeof( header ) );
+        if ( std::memcmp( header.magic, magic, sizeof( magic ) ) != 0 || header.version != version )
+            return false;
+
+        const auto rootBytes = std::uint64_t( header.rootCount ) * sizeof( Root );
+        const auto libraryBytes = std::uint64_t( header.libraryCount ) * sizeof( Library );
+        const auto manifestBytes = std::uint64_t( header.manifestCount ) * sizeof( Manifest );
+        if ( sizeof( Header ) + rootBytes + libraryBytes + manifestBytes + header.stringBytes != data.size() )
+            return false;
+
+        const char *rootData = data.data() + sizeof( Header );
+        const char *libraryData = rootData + rootBytes;
+        const char *manifestData = libraryData + libraryBytes;
+        const std::string_view strings( manifestData + manifestBytes, header.stringBytes );
+
+        bool valid = true;
+        auto string = [&]( uint32 offset, uint32 length ) -> std::string_view
+        {
+            if ( std::uint64_t( offset ) + length > strings.size() )
+            {
+                valid = false;
+                return {};
+            }
+            return strings.substr( offset, length );
+        };
+
+        manifests.reserve( header.manifestCount );
+        for ( uint32 i = 0; i < header.manifestCount; i++ )
+        {
+            Manifest record{};
+            std::memcpy( &record, manifestData + i * sizeof( Manifest ), sizeof( Manifest ) );
+            manifests.push_back( { string( record.file, record.fileLength ), record.stamp, record.appid,
+                                   string( record.name, record.nameLength ), string( record.installDir, record.installDirLength ), record.engineFlags } );
+        }
+
+        roots.reserve( header.rootCount );
+        for ( uint32 i = 0; i < header.rootCount; i++ )
+        {
+            Root record{};
+            std::memcpy( &record, rootData + i * sizeof( Root ), sizeof( Root ) );
+            roots.push_back( { string( record.path, record.pathLength ), record.libraryFolders } );
+        }
+
+        libraries.reserve( header.libraryCount );
+        for ( uint32 i = 0; i < header.libraryCount; i++ )
+        {
+            Library record{};
+            std::memcpy( &record, libraryData + i * sizeof( Library ), sizeof( Library ) );
+            if ( std::uint64_t( record.firstManifest ) + record.manifestCount > manifests.size() || record.root >= roots.size() )
+                return Invalidate();
+            libraries.push_back( { string( record.path, record.pathLength ), record.root, record.stamp,
+                                   std::span<const CachedManifest>( manifests ).subspan( record.firstManifest, record.manifestCount ) } );
+        }
+
+        if ( !valid )
+            return Invalidate();
+        return true;
+    }
+
+    // In the order the scan found them, the first one is the primary install.
+    [[nodiscard]] std::span<const CachedRoot> Roots() const
+    {
+        return roots;
+    }
+
+    [[nodiscard]] std::span<const CachedLibrary> Libraries() const
+    {
+        return libraries;
+    }
+
+    [[nodiscard]] const CachedLibrary *FindLibrary( std::string_view path ) const
+    {
+        for ( const auto &library : libraries )
+        {
+            if ( library.path == path )
+                return &library;
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] static const CachedManifest *FindManifest( const CachedLibrary &library, std::string_view file )
+    {
+        const auto it = std::lower_bound( library.manifests.begin(), library.manifests.end(), file, []( const CachedManifest &manifest, std::string_view name )
+        {
+            return manifest.file < name;
+        } );
+        if ( it == library.manifests.end() || it->file != file )
+            return nullptr;
+        return &*it;
+    }
+
+    // Written next to the destination and renamed over it, so readers never see a partial file.
+    static bool Write( const std::string &path, std::span<const CachedRoot> cachedRoots, std::span<const CachedLibrary> cachedLibraries )
+    {
+        std::string strings;
+        auto addString = [&strings]( std::string_view text, uint32 &offset, uint32 &length )
+        {
+            offset = static_cast<uint32>( strings.size() );
+            length = static_cast<uint32>( text.size() );
+            strings.append( text );
+        };
+
+        std::vector<Root> rootRecords;
+        for ( const auto &root : cachedRoots )
+        {
+            Root record{};
+            addString( root.path, record.path, record.pathLength );
+            record.libraryFolders = root.libraryFolders;
+            rootRecords.push_back( record );
+        }
+
+        std::vector<Library> libraryRecords;
+        std::vector<Manifest> manifestRecords;
+        for ( const auto &library : cachedLibraries )
+        {
+            Library record{};
+            addString( library.path, record.path, record.pathLength );
+            record.root = library.root;
+            record.stamp = library.stamp;
+            record.firstManifest = static_cast<uint32>( manifestRecords.size() );
+            record.manifestCount = static_cast<uint32>( library.manifests.size() );
+            libraryRecords.push_back( record );
+
+            for ( const auto &manifest : library.manifests )
+            {
+                Manifest manifestRecord{};
+                addString( manifest.file, manifestRecord.file, manifestRecord.fileLength );
+                manifestRecord.stamp = manifest.stamp;
+                manifestRecord.appid = manifest.appid;
+                addString( manifest.name, manifestRecord.name, manifestRecord.nameLength );
+                addString( manifest.installDir, manifestRecord.installDir, manifestRecord.installDirLength );
+                manifestRecord.engineFlags = manifest.engineFlags;
+                manifestRecords.push_back( manifestRecord );
+            }
+        }
+
+        Header header{};
+        std::memcpy( header.magic, magic, sizeof( magic ) );
+        header.version = version;
+        header.rootCount = static_cast<uint32>( rootRecords.size() );
+        header.libraryCount = static_cast<uint32>( libraryRecords.size() );
+        header.manifestCount = static_cast<uint32>( manifestRecords.size() );
+        header.stringBytes = static_cast<uint32>( strings.size() );
+
+        std::string image;
+        image.reserve( sizeof( header ) + rootRecords.size() * sizeof( Root ) + libraryRecords.size() * sizeof( Library ) + manifestRecords.size() * sizeof( Manifest ) + strings.size() );
+        image.append( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+        image.append( reinterpret_cast<const char *>( rootRecords.data() ), rootRecords.size() * sizeof( Root ) );
+        image.append( reinterpret_cast<const char *>( libraryRecords.data() ), libraryRecords.size() * sizeof( Library ) );
+        image.append( reinterpret_cast<const char *>( manifestRecords.data() ), manifestRecords.size() * sizeof( Manifest ) );
+        image.append( strings );
+        return SappAtomicFile::Replace( path, image );
+    }
+
+private:
+    static constexpr char magic[4] = { 'S', 'A', 'P', 'C' };
+    static constexpr uint32 version = 3;
+
+    struct Header
+    {
+        char magic[4];
+        uint32 version;
+        uint32 rootCount;
+        uint32 libraryCount;
+        uint32 manifestCount;
+        uint32 stringBytes;
+    };
+
+    struct Root
+    {
+        uint32 path;
+        uint32 pathLength;
+        SappFileStamp libraryFolders;
+    };
+
+    struct Library
+    {
+        uint32 path;
+        uint32 pathLength;
+        SappFileStamp stamp;
+        uint32 firstManifest;
+        uint32 manifestCount;
+        uint32 root;
+        uint32 reserved;
+    };
+
+    struct Manifest
+    {
+        uint32 file;
+        uint32 fileLength;
+        SappFileStamp stamp;
+        AppId_t appid;
+        uint32 name;
+        uint32 nameLength;
+        uint32 installDir;
+        uint32 installDirLength;
+        uint32 engineFlags;
+    };
+
+    bool Invalidate()
+    {
+        roots.clear();
+        libraries.clear();
+        manifests.clear();
+        file.Close();
+        return false;
+    }
+
+    SappMappedFile file;
+    std::vector<CachedRoot> roots;
+    std::vector<CachedLibrary> libraries;
+    std::vector<CachedManifest> manifests;
+};
+
+// One mount of a gameinfo's SearchPaths.
+struct SappSearchPath
+{
+    // The path IDs it is mounted under, as written ("game+mod", "Game", ...).
+    std::string keys;
+    // Absolute folder, or the _dir.vpk file of a VPK mount.
+    std::string path;
+    bool vpk = false;
+
+    // Case-insensitive, HasKey( "mod" ) is true for "game+mod".
+    [[nodiscard]] bool HasKey( std::string_view key ) const
+    {
+        std::string_view rest = keys;
+        while ( !rest.empty() )
+        {
+            const auto plus = rest.find( '+' );
+            if ( SappKeyValuesTokenizer::KeyEquals( rest.substr( 0, plus ), key ) )
+                return true;
+            rest = plus == std::string_view::npos ? std::string_view() : rest.substr( plus + 1 );
+        }
+        return false;
+    }
+};
+
+// A parsed gameinfo.txt (Source) or gameinfo.gi (Source 2): the game's title and its SearchPaths in
+// mount order. |gameinfo_path| is the folder holding the file; |all_source_engine_paths| and
+// relative paths start at the folder above it, which is the install folder for Source and
+// <install>/game for Source 2. Wildcard mounts ("custom/*") are expanded to the folders and VPKs
+// they match, and a "name.vpk" mount refers to name_dir.vpk.
+class SappGameInfo
+{
+public:
+    bool Load( const std::string &gameInfoFile )
+    {
+        using TokenType = SappKeyValuesTokenizer::TokenType;
+
+        file = gameInfoFile;
+        game.clear();
+        searchPaths.clear();
+        stamp = SappFileStamp::Of( file );
+        const SappMappedFile contents( file );
+        if ( !contents.IsOpen() )
+            return false;
+
+        const auto gameInfoPath = fs::path( file ).parent_path();
+        const auto basePath = gameInfoPath.parent_path().string();
+
+        SappKeyValuesTokenizer tokenizer( contents.View() );
+        if ( !tokenizer.EnterBlock( "GameInfo" ) )
+            return false;
+
+        // Depth 0 is GameInfo itself; only FileSystem > SearchPaths is entered.
+        int depth = 0;
+        bool inFileSystem = false;
+        bool inSearchPaths = false;
+        while ( depth >= 0 )
+        {
+            const auto key = tokenizer.Next();
+            if ( key.type == TokenType::BlockEnd )
+            {
+                if ( inSearchPaths )
+                    inSearchPaths = false;
+                else if ( inFileSystem )
+                    inFileSystem = false;
+                depth--;
+                continue;
+            }
+            if ( key.type != TokenType::String )
+                return false;
+
+            const auto value = tokenizer.Next();
+            if ( value.type == TokenType::BlockBegin )
+            {
+                if ( depth == 0 && SappKeyValuesTokenizer::KeyEquals( key.text, "FileSystem" ) )
+                    inFileSystem = true;
+                else if ( depth == 1 && inFileSystem && SappKeyValuesTokenizer::KeyEquals( key.text, "SearchPaths" ) )
+                    inSearchPaths = true;
+                else if ( !tokenizer.SkipBlock() )
+                    return false;
+                else
+                    continue;
+                depth++;
+                continue;
+            }
+            if ( value.type != TokenType::String )
+                return false;
+
+            if ( depth == 0 && SappKeyValuesTokenizer::KeyEquals( key.text, "game" ) )
+                game = SappKeyValuesTokenizer::Unescape( value.text );
+            else if ( inSearchPaths )
+                AddSearchPath( SappKeyValuesTokenizer::Unescape( key.text ), Resolve( SappKeyValuesTokenizer::Unescape( value.text ), gameInfoPath.string(), basePath ) );
+        }
+        return true;
+    }
+
+    [[nodiscard]] const std::string &GetFile() const
+    {
+        return file;
+    }
+
+    [[nodiscard]] std::string_view GetGame() const
+    {
+        return game;
+    }
+
+    [[nodiscard]] std::span<const SappSearchPath> GetSearchPaths() const
+    {
+        return searchPaths;
+    }
+
+    // The file as it was when it was loaded.
+    [[nodiscard]] const SappFileStamp &GetStamp() const
+    {
+        return stamp;
+    }
+
+private:
+    static std::string Resolve( std::string value, const std::string &gameInfoPath, const std::string &basePath )
+    {
+        std::replace( value.begin(), value.end(), '\\', '/' );
+        std::string path;
+        if ( value.starts_with( "|gameinfo_path|" ) )
+            path = gameInfoPath + "/" + value.substr( 15 );
+        else if ( value.starts_with( "|all_source_engine_paths|" ) )
+            path = basePath + "/" + value.substr( 25 );
+        else if ( fs::path( value ).is_absolute() )
+            path = std::move( value );
+        else
+            path = basePath + "/" + value;
+
+        while ( path.ends_with( "/." ) || path.ends_with( "/" ) )
+            path.resize( path.size() - ( path.ends_with( "/" ) ? 1 : 2 ) );
+        return fs::path( path ).make_preferred().string();
+    }
+
+    void AddSearchPath( std::string keys, const std::string &path )
+    {
+        std::error_code ec;
+        if ( path.ends_with( "*" ) )
+        {
+            const auto folder = fs::path( path ).parent_path();
+            std::vector<fs::path> matches;
+            for ( const auto &entry : fs::directory_iterator( folder, fs::directory_options::skip_permission_denied, ec ) )
+            {
+                if ( entry.is_directory( ec ) || ( entry.path().extension() == ".vpk" && entry.path().stem().string().ends_with( "_dir" ) ) )
+                    matches.push_back( entry.path() );
+            }
+            std::sort( matches.begin(), matches.end() );
+            for ( const auto &match : matches )
+                searchPaths.push_back( { keys, match.string(), match.extension() == ".vpk" } );
+            return;
+        }
+
+        if ( path.ends_with( ".vpk" ) )
+        {
+            auto directory = path;
+            if ( !path.ends_with( "_dir.vpk" ) && !fs::exists( path, ec ) )
+                directory.insert( directory.size() - 4, "_dir" );
+            searchPaths.push_back( { std::move( keys ), std::move( directory ), true } );
+            return;
+        }
+        searchPaths.push_back( { std::move( keys ), path, false } );
+    }
+
+    std::string file;
+    std::string game;
+    std::vector<SappSearchPath> searchPaths;
+    SappFileStamp stamp;
+};
+
+// Relative path -> the search path that wins for it, over the mounts of one path ID of a
+// SappGameInfo. Every mount is listed by its own worker (folders recursively, VPKs from their
+// directory tree), then each file goes to the first mount holding it, so resolving a path is one
+// hash probe instead of a stat per mount. Lookups are case-insensitive and take either separator,
+// like the engine's file system.
+class SappSearchPathIndex
+{
+public:
+    struct Hit
+    {
+        const SappSearchPath *mount;
+        // As spelled in the folder or VPK.
+        std::string_view relative;
+
+        // The file on disk for a folder mount; for a VPK mount, the VPK.
+        [[nodiscard]] std::string FullPath() const
+        {
+            if ( mount->vpk )
+                return mount->path;
+            auto path = mount->path;
+            path.push_back( CORRECT_PATH_SEPARATOR );
+            path.append( relative );
+            return path;
+        }
+    };
+
+    explicit SappSearchPathIndex( SappGameInfo info, std::string_view pathId = "game", unsigned int workerCount = 0 )
+        : gameInfo( std::move( info ) )
+    {
+        const auto searchPaths = gameInfo.GetSearchPaths();
+        for ( uint32 i = 0; i < searchPaths.size(); i++ )
+        {
+            if ( searchPaths[i].HasKey( pathId ) )
+                mounts.push_back( i );
+        }
+
+        struct Listing
+        {
+            std::vector<std::string> files;
+            std::vector<std::pair<std::string, SappFileStamp>> stamps;
+        };
+        std::vector<Listing> listings( mounts.size() );
+        SappWorkStealingPool::Run( mounts.size(), workerCount, [&]( std::size_t index, unsigned int )
+        {
+            const auto &mount = searchPaths[mounts[index]];
+            auto &listing = listings[index];
+            listing.stamps.emplace_back( mount.path, SappFileStamp::Of( mount.path ) );
+            if ( mount.vpk )
+                ListVpk( mount.path, listing.files );
+            else
+                ListFolder( mount.path, listing.files, listing.stamps );
+        } );
+
+        std::size_t total = 0;
+        for ( const auto &listing : listings )
+            total += listing.files.size();
+        files.reserve( total );
+
+        std::string lower;
+        for ( std::size_t index = 0; index < listings.size(); index++ )
+        {
+            for ( const auto &relative : listings[index].files )
+            {
+                Normalize( relative, lower );
+                if ( files.contains( lower ) )
+                    continue;
+                const auto stored = arena.Store( relative );
+                files.emplace( lower == relative ? stored : arena.Store( lower ), Entry{ &searchPaths[mounts[index]], stored } );
+            }
+            for ( auto &stamp : listings[index].stamps )
+                stamps.push_back( std::move( stamp ) );
+        }
+    }
+
+    // Hits point into the index.
+    SappSearchPathIndex( const SappSearchPathIndex & ) = delete;
+    SappSearchPathIndex &operator=( const SappSearchPathIndex & ) = delete;
+
+    // Doesn't allocate for paths shorter than SAPP_MAX_PATH.
+    [[nodiscard]] std::optional<Hit> Find( std::string_view relative ) const
+    {
+        char buffer[SAPP_MAX_PATH];
+        std::string heap;
+        std::string_view key;
+        if ( relative.size() <= sizeof( buffer ) )
+        {
+            for ( std::size_t i = 0; i < relative.size(); i++ )
+                buffer[i] = relative[i] == '\\' ? '/' : SappKeyValuesTokenizer::ToLower( relative[i] );
+            key = std::string_view( buffer, relative.size() );
+        }
+        else
+        {
+            Normalize( relative, heap );
+            key = heap;
+        }
+
+        const auto found = files.find( key );
+        if ( found == files.end() )
+            return std::nullopt;
+        return Hit{ found->second.mount, found->second.relative };
+    }
+
+    // Whether the gameinfo file, a mounted VPK or any indexed folder changed since the index was
+    // built; a stat each.
+    [[nodiscard]] bool IsStale() const
+    {
+        if ( SappFileStamp::Of( gameInfo.GetFile() ) != gameInfo.GetStamp() )
+            return true;
+        return std::any_of( stamps.begin(), stamps.end(), []( const auto &stamp ) { return SappFileStamp::Of( stamp.first ) != stamp.second; } );
+    }
+
+    [[nodiscard]] const SappGameInfo &GetGameInfo() const
+    {
+        return gameInfo;
+    }
+
+    [[nodiscard]] std::size_t GetFileCount() const
+    {
+        return files.size();
+    }
+
+private:
+    struct Entry
+    {
+        const SappSearchPath *mount;
+        std::string_view relative;
+    };
+
+    static void Normalize( std::string_view relative, std::string &out )
+    {
+        out.assign( relative );
+        for ( auto &c : out )
+            c = c == '\\' ? '/' : SappKeyValuesTokenizer::ToLower( c );
+    }
+
+    static void ListFolder( const std::string &folder, std::vector<std::string> &out, std::vector<std::pair<std::string, SappFileStamp>> &stamps )
+    {
+        std::error_code ec;
+        for ( fs::recursive_directory_iterator it( folder, fs::directory_options::skip_permission_denied, ec ), end; !ec && it != end; it.increment( ec ) )
+        {
+            auto path = it->path().string();
+            if ( it->is_directory( ec ) )
+            {
+                auto stamp = SappFileStamp::Of( path );
+                stamps.emplace_back( std::move( path ), stamp );
+                continue;
+            }
+            auto relative = path.substr( std::min( path.size(), folder.size() + 1 ) );
+            std::replace( relative.begin(), relative.end(), '\\', '/' );
+            out.push_back( std::move( relative ) );
+        }
+    }
+
+    // A VPK's _dir file: a header, then the directory tree as extension > path > file name strings,
+    // each file followed by 18 bytes of entry data and its preload bytes.
+    static void ListVpk( const std::string &path, std::vector<std::string> &out )
+    {
+        const SappMappedFile vpk( path );
+        const auto data = vpk.View();
+        uint32 header[3] = {};
+        if ( data.size() < sizeof( header ) )
+            return;
+        std::memcpy( header, data.data(), sizeof( header ) );
+        if ( header[0] != 0x55AA1234u || ( header[1] != 1 && header[1] != 2 ) )
+            return;
+
+        const std::size_t treeStart = header[1] == 1 ? 12 : 28;
+        if ( treeStart + header[2] > data.size() )
+            return;
+        const auto tree = data.substr( treeStart, header[2] );
+        std::size_t cursor = 0;
+        auto next = [&]( std::string_view &text )
+        {
+            const auto terminator = tree.find( '\0', cursor );
+            if ( terminator == std::string_view::npos )
+                return false;
+            text = tree.substr( cursor, terminator - cursor );
+            cursor = terminator + 1;
+            return true;
+        };
+
+        std::string_view extension, directory, name;
+        while ( next( extension ) && !extension.empty() )
+        {
+            while ( next( directory ) && !directory.empty() )
+            {
+                while ( next( name ) && !name.empty() )
+                {
+                    if ( cursor + 18 > tree.size() )
+                        return;
+                    std::uint16_t preload = 0;
+                    std::memcpy( &preload, tree.data() + cursor + 4, sizeof( preload ) );
+                    cursor += 18 + preload;
+
+                    std::string file;
+                    if ( directory != " " )
+                    {
+                        file.append( directory );
+                        file.push_back( '/' );
+                    }
+                    file.append( name );
+                    if ( extension != " " )
+                    {
+                        file.push_back( '.' );
+                        file.append( extension );
+                    }
+                    out.push_back( std::move( file ) );
+                }
+            }
+        }
+    }
+
+    SappGameInfo gameInfo;
+    // Indices into gameInfo.GetSearchPaths() of the mounts with the path ID, in mount order.
+    std::vector<uint32> mounts;
+    SappStringArena arena;
+    // Keyed by the lower-cased path, both stored in arena.
+    std::unordered_map<std::string_view, Entry> files;
+    std::vector<std::pair<std::string, SappFileStamp>> stamps;
+};
+
+struct SappDiskUsageOptions
+{
+    // Folders read at once, 0 = one per hardware thread. Lower it to leave the disk to others.
+    unsigned int maxConcurrency = 0;
+    // Take SizeOnDisk from manifests whose StateFlags is exactly 4 (fully installed, nothing to
+    // update or download) instead of walking the install folder.
+    bool trustManifest = true;
+    // Batch the statx calls of a folder through io_uring (Linux 5.6+, falls back to plain statx
+    // when the ring can't be set up). The kernel hands them to its worker threads, which pays off
+    // when metadata has to come from slow or remote storage; when it is cached, one statx call per
+    // file is cheaper.
+    bool useIoUring = false;
+    // Checked before every folder; a stopped walk reports what it counted so far as incomplete.
+    std::stop_token stop{};
+};
+
+struct SappInstallSize
+{
+    AppId_t appid = k_uAppIdInvalid;
+    // Apparent size of the regular files, what SizeOnDisk counts.
+    std::uint64_t bytes = 0;
+    // Regular files counted, 0 when bytes came from the manifest.
+    std::uint64_t files = 0;
+    // Index into SappDiskUsageReport::libraries.
+    uint32 library = 0;
+    bool fromManifest = false;
+    bool complete = true;
+};
+
+struct SappDiskUsageReport
+{
+    struct Library
+    {
+        // The library's steamapps folder.
+        std::string path;
+        std::uint64_t bytes = 0;
+        uint32 apps = 0;
+    };
+
+    // In game list order.
+    std::vector<SappInstallSize> apps;
+    std::vector<Library> libraries;
+    bool complete = true;
+};
+
+// Sums the regular files below a set of folders. Folders are handed to at most maxConcurrency
+// threads as they are discovered, so one deep install doesn't serialize the walk. On Linux every
+// folder is read with getdents64 and its files are stat'ed relative to the folder's descriptor,
+// one statx call each or batched through io_uring (IORING_OP_STATX) with useIoUring. A file with
+// several hard links is counted once per Measure() call, for whichever folder reaches it first;
+// the portable walk can't tell hard links apart and counts each.
+class SappDiskUsage
+{
+public:
+    struct Usage
+    {
+        std::uint64_t bytes = 0;
+        std::uint64_t files = 0;
+        bool complete = true;
+    };
+
+    // One Usage per folder, a folder that can't be read counts as empty.
+    // trustManifest is ignored.
+    static std::vector<Usage> Measure( std::span<const std::string> folders, const SappDiskUsageOptions &options = {} )
+    {
+        Walk walk( folders.size() );
+        for ( std::size_t i = 0; i < folders.size(); i++ )
+            walk.pending.push_back( { folders[i], i } );
+        walk.outstanding = folders.size();
+
+        auto worker = [&]
+        {
+            Walker walker( walk, options.useIoUring );
+            while ( true )
+            {
+                Folder folder;
+                {
+                    std::unique_lock lock( walk.lock );
+                    walk.ready.wait( lock, [&] { return !walk.pending.empty() || walk.outstanding == 0; } );
+                    if ( walk.pending.empty() )
+                        return;
+                    // Depth first keeps the queue short.
+                    folder = std::move( walk.pending.back() );
+                    walk.pending.pop_back();
+                }
+
+                std::vector<Folder> children;
+                if ( options.stop.stop_requested() )
+                    walk.totals[folder.root].incomplete.store( true, std::memory_order_relaxed );
+                else
+                    walker.Visit( folder, children );
+
+                std::scoped_lock lock( walk.lock );
+                walk.outstanding += children.size();
+                std::move( children.begin(), children.end(), std::back_inserter( walk.pending ) );
+                if ( --walk.outstanding == 0 || children.size() > 1 )
+                    walk.ready.notify_all();
+                else if ( children.size() == 1 )
+                    walk.ready.notify_one();
+            }
+        };
+
+        {
+            const auto workerCount = SappWorkStealingPool::ResolveWorkerCount( options.maxConcurrency );
+            std::vector<std::jthread> threads;
+            threads.reserve( workerCount - 1 );
+            for ( unsigned int w = 1; w < workerCount; w++ )
+                threads.emplace_back( worker );
+            worker();
+        }
+
+        std::vector<Usage> usage( folders.size() );
+        for ( std::size_t i = 0; i < folders.size(); i++ )
+            usage[i] = { walk.totals[i].bytes.load(), walk.totals[i].files.load(), !walk.totals[i].incomplete.load() };
+        return usage;
+    }
+
+private:
+    struct Folder
+    {
+        std::string path;
+        // Index of the folder given to Measure() it lies in.
+        std::size_t root;
+    };
+
+    struct Totals
+    {
+        std::atomic<std::uint64_t> bytes{ 0 };
+        std::atomic<std::uint64_t> files{ 0 };
+        std::atomic<bool> incomplete{ false };
+    };
+
+    struct Walk
+    {
+        explicit Walk( std::size_t folders )
+            : totals( folders )
+        {
+        }
+
+        std::mutex lock;
+        std::condition_variable ready;
+        std::vector<Folder> pending;
+        // Folders pending or being read; the walk is over when it drops to 0.
+        std::size_t outstanding = 0;
+        std::vector<Totals> totals;
+
+        std::mutex linkLock;
+        // ( device, inode ) of every file with more than one link seen so far.
+        std::set<std::pair<std::uint64_t, std::uint64_t>> links;
+    };
+
+#ifdef SAPP_HAS_IO_URING
+    // A submission/completion ring used for nothing but statx, owned by one thread.
+    class StatxRing
+    {
+    public:
+        static constexpr unsigned int depth = 64;
+
+        StatxRing()
+        {
+            io_uring_params params{};
+            fd = static_cast<int>( syscall( __NR_io_uring_setup, depth, &params ) );
+            if ( fd < 0 )
+                return;
+
+            const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+            sqSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+            cqSize = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+            if ( singleMap )
+                sqSize = cqSize = std::max( sqSize, cqSize );
+            sqesSize = params.sq_entries * sizeof( io_uring_sqe );
+
+            sqRing = mmap( nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+            cqRing = singleMap ? sqRing : mmap( nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+            auto sqesMap = mmap( nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+            if ( sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqesMap == MAP_FAILED )
+            {
+                if ( sqesMap != MAP_FAILED )
+                    munmap( sqesMap, sqesSize );
+                Close();
+                return;
+            }
+
+            auto at = []( void *ring, std::uint32_t offset ) { return reinterpret_cast<unsigned *>( static_cast<char *>( ring ) + offset ); };
+            sqes = static_cast<io_uring_sqe *>( sqesMap );
+            sqTail = at( sqRing, params.sq_off.tail );
+            sqMask = *at( sqRing, params.sq_off.ring_mask );
+            sqArray = at( sqRing, params.sq_off.array );
+            cqHead = at( cqRing, params.cq_off.head );
+            cqTail = at( cqRing, params.cq_off.tail );
+            cqMask = *at( cqRing, params.cq_off.ring_mask );
+            cqes = reinterpret_cast<io_uring_cqe *>( static_cast<char *>( cqRing ) + params.cq_off.cqes );
+            entries = std::min( params.sq_entries, params.cq_entries );
+        }
+
+        ~StatxRing()
+        {
+            Close();
+        }
+
+        StatxRing( const StatxRing & ) = delete;
+        StatxRing &operator=( const StatxRing & ) = delete;
+
+        [[nodiscard]] bool Available() const
+        {
+            return fd >= 0;
+        }
+
+        [[nodiscard]] unsigned int Capacity() const
+        {
+            return entries;
+        }
+
+        // statx of names[i] relative to directory into results[i], status[i] is 0 or -errno. At most
+        // Capacity() names. Returns false, with nothing left in flight, once the ring turns out to be
+        // unusable (no IORING_OP_STATX, a failing io_uring_enter); it is closed then.
+        bool Stat( int directory, std::span<const char *const> names, std::span<struct statx> results, std::span<int> status )
+        {
+            const auto count = static_cast<unsigned int>( names.size() );
+            auto tail = *sqTail;
+            for ( unsigned int i = 0; i < count; i++, tail++ )
+            {
+                const auto index = tail & sqMask;
+                auto &sqe = sqes[index];
+                sqe = {};
+                sqe.opcode = IORING_OP_STATX;
+                sqe.fd = directory;
+                sqe.addr = reinterpret_cast<std::uint64_t>( names[i] );
+                sqe.len = statxMask;
+                sqe.off = reinterpret_cast<std::uint64_t>( &results[i] );
+                sqe.statx_flags = statxFlags;
+                sqe.user_data = i;
+                sqArray[index] = index;
+            }
+            std::atomic_ref( *sqTail ).store( tail, std::memory_order_release );
+
+            unsigned int submitted = 0;
+            unsigned int completed = 0;
+            bool failed = false;
+            while ( completed < count )
+            {
+                if ( !failed )
+                {
+                    const auto result = syscall( __NR_io_uring_enter, fd, count - submitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0 );
+                    if ( result >= 0 )
+                        submitted += static_cast<unsigned int>( result );
+                    else if ( errno != EINTR && errno != EAGAIN && errno != EBUSY )
+                        failed = true;
+                }
+                // The entries that never went out are dropped with the ring, the ones that did
+                // still write into results and have to be waited for.
+                if ( failed && completed == submitted )
+                    break;
+
+                auto head = *cqHead;
+                const auto available = std::atomic_ref( *cqTail ).load( std::memory_order_acquire );
+                for ( ; head != available; head++, completed++ )
+                {
+                    const auto &cqe = cqes[head & cqMask];
+                    status[cqe.user_data] = cqe.res;
+                    failed |= cqe.res == -EINVAL;
+                }
+                std::atomic_ref( *cqHead ).store( head, std::memory_order_release );
+                if ( failed && completed < submitted )
+                    std::this_thread::yield();
+            }
+
+            if ( failed )
+                Close();
+            return !failed;
+        }
+
+    private:
+        void Close()
+        {
+            if ( sqesSize && sqes )
+                munmap( sqes, sqesSize );
+            if ( cqRing && cqRing != MAP_FAILED && cqRing != sqRing )
+                munmap( cqRing, cqSize );
+            if ( sqRing && sqRing != MAP_FAILED )
+                munmap( sqRing, sqSize );
+            if ( fd >= 0 )
+                ::close( fd );
+            sqes = nullptr;
+            sqRing = cqRing = nullptr;
+            fd = -1;
+        }
+
+        int fd = -1;
+        unsigned int entries = 0;
+        void *sqRing = nullptr;
+        void *cqRing = nullptr;
+        std::size_t sqSize = 0;
+        std::size_t cqSize = 0;
+        std::size_t sqesSize = 0;
+        io_uring_sqe *sqes = nullptr;
+        unsigned *sqTail = nullptr;
+        unsigned sqMask = 0;
+        unsigned *sqArray = nullptr;
+        unsigned *cqHead = nullptr;
+        unsigned *cqTail = nullptr;
+        unsigned cqMask = 0;
+        io_uring_cqe *cqes = nullptr;
+    };
+#endif
+
+#ifdef __linux__
+    static constexpr unsigned int statxMask = STATX_TYPE | STATX_SIZE | STATX_INO | STATX_NLINK;
+    static constexpr int statxFlags = AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC;
+    static constexpr std::size_t batchSize = 64;
+
+    class Walker
+    {
+    public:
+        Walker( Walk &walk, [[maybe_unused]] bool useIoUring )
+            : walk( walk )
+        {
+#ifdef SAPP_HAS_IO_URING
+            if ( useIoUring )
+                ring.emplace();
+#endif
+        }
+
+        void Visit( const Folder &folder, std::vector<Folder> &children )
+        {
+            const int fd = ::open( folder.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+            if ( fd < 0 )
+                return;
+
+            Usage usage;
+            alignas( SappLinuxDirent64 ) char buffer[SAPP_MAX_PATH * 4];
+            std::array<const char *, batchSize> names;
+            std::size_t named = 0;
+            // Names point into buffer, so every batch is stat'ed before the next getdents64.
+            while ( true )
+            {
+                const auto length = syscall( SYS_getdents64, fd, buffer, sizeof( buffer ) );
+                if ( length <= 0 )
+                    break;
+
+                for ( long offset = 0; offset < length; )
+                {
+                    const auto entry = reinterpret_cast<const SappLinuxDirent64 *>( buffer + offset );
+                    offset += entry->d_reclen;
+
+                    const char *name = entry->d_name;
+                    if ( name[0] == '.' && ( name[1] == '\0' || ( name[1] == '.' && name[2] == '\0' ) ) )
+                        continue;
+                    if ( entry->d_type == DT_DIR )
+                        children.push_back( { folder.path + CORRECT_PATH_SEPARATOR + name, folder.root } );
+                    else if ( entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN )
+                        names[named++] = name;
+
+                    if ( named == names.size() )
+                    {
+                        StatBatch( fd, folder, std::span( names ).first( named ), usage, children );
+                        named = 0;
+                    }
+                }
+                StatBatch( fd, folder, std::span( names ).first( named ), usage, children );
+                named = 0;
+            }
+            ::close( fd );
+
+            auto &totals = walk.totals[folder.root];
+            totals.bytes.fetch_add( usage.bytes, std::memory_order_relaxed );
+            totals.files.fetch_add( usage.files, std::memory_order_relaxed );
+        }
+
+    private:
+        void StatBatch( int fd, const Folder &folder, std::span<const char *const> names, Usage &usage, std::vector<Folder> &children )
+        {
+            if ( names.empty() )
+                return;
+
+            const auto results = std::span( stats ).first( names.size() );
+            const auto status = std::span( statuses ).first( names.size() );
+#ifdef SAPP_HAS_IO_URING
+            if ( ring && ring->Available() && names.size() <= ring->Capacity() && ring->Stat( fd, names, results, status ) )
+            {
+                for ( std::size_t i = 0; i < names.size(); i++ )
+                {
+                    if ( status[i] == 0 )
+                        Account( results[i], folder, names[i], usage, children );
+                }
+                return;
+            }
+#endif
+            for ( std::size_t i = 0; i < names.size(); i++ )
+            {
+                if ( statx( fd, names[i], statxFlags, statxMask, &results[i] ) == 0 )
+                    Account( results[i], folder, names[i], usage, children );
+            }
+        }
+
+        void Account( const struct statx &stat, const Folder &folder, const char *name, Usage &usage, std::vector<Folder> &children )
+        {
+            if ( S_ISDIR( stat.stx_mode ) )
+            {
+                children.push_back( { folder.path + CORRECT_PATH_SEPARATOR + name, folder.root } );
+                return;
+            }
+            if ( !S_ISREG( stat.stx_mode ) )
+                return;
+
+            if ( stat.stx_nlink > 1 )
+            {
+                const auto device = static_cast<std::uint64_t>( stat.stx_dev_major ) << 32 | stat.stx_dev_minor;
+                std::scoped_lock lock( walk.linkLock );
+                if ( !walk.links.emplace( device, stat.stx_ino ).second )
+                    return;
+            }
+            usage.bytes += stat.stx_size;
+            usage.files++;
+        }
+
+        Walk &walk;
+        std::array<struct statx, batchSize> stats;
+        std::array<int, batchSize> statuses;
+#ifdef SAPP_HAS_IO_URING
+        std::optional<StatxRing> ring;
+#endif
+    };
+#else
+    class Walker
+    {
+    public:
+        Walker( Walk &walk, bool )
+            : walk( walk )
+        {
+        }
+
+        void Visit( const Folder &folder, std::vector<Folder> &children )
+        {
+            Usage usage;
+            std::error_code ec;
+            for ( const auto &entry : fs::directory_iterator( folder.path, fs::directory_options::skip_permission_denied, ec ) )
+            {
+                if ( entry.is_symlink( ec ) )
+                    continue;
+                if ( entry.is_directory( ec ) )
+                {
+                    children.push_back( { entry.path().string(), folder.root } );
+                }
+                else if ( entry.is_regular_file( ec ) )
+                {
+                    usage.bytes += entry.file_size( ec );
+                    usage.files++;
+                }
+            }
+
+            auto &totals = walk.totals[folder.root];
+            totals.bytes.fetch_add( usage.bytes, std::memory_order_relaxed );
+            totals.files.fetch_add( usage.files, std::memory_order_relaxed );
+        }
+
+    private:
+        Walk &walk;
+    };
+#endif
+};
+
+struct SappWorkshopItem
+{
+    std::uint64_t id = 0;
+    // Bytes, as recorded by Steam.
+    std::uint64_t size = 0;
+    // Unix times: when the installed version was published and when Steam last touched the item.
+    std::uint64_t timeUpdated = 0;
+    std::uint64_t timeTouched = 0;
+    // <library>/workshop/content/<appid>/<id>
+    std::string path;
+};
+
+// The installed workshop items of one app, read from <library>/workshop/appworkshop_<appid>.acf
+// (WorkshopItemsInstalled, with timetouched merged in from WorkshopItemDetails).
+class SappWorkshopContent
+{
+public:
+    // library is the steamapps folder the app was found in. Returns false when the manifest can't
+    // be read or isn't a workshop manifest; GetStamp() tells which.
+    bool Load( AppId_t appID, std::string_view library )
+    {
+        using TokenType = SappKeyValuesTokenizer::TokenType;
+
+        appid = appID;
+        items.clear();
+        sizeOnDisk = 0;
+        needsUpdate = needsDownload = loaded = false;
+        std::string folder( library );
+        folder.append( CORRECT_PATH_SEPARATOR_S "workshop" CORRECT_PATH_SEPARATOR_S );
+        manifest = folder + "appworkshop_" + std::to_string( appid ) + ".acf";
+        stamp = SappFileStamp::Of( manifest );
+        if ( !stamp.Exists() )
+            return false;
+
+        const SappMappedFile file( manifest );
+        SappKeyValuesTokenizer tokenizer( file.View() );
+        if ( !file.IsOpen() || !tokenizer.EnterBlock( "AppWorkshop" ) )
+            return false;
+
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> touched;
+        while ( true )
+        {
+            const auto key = tokenizer.Next();
+            if ( key.type == TokenType::BlockEnd )
+                break;
+            if ( key.type != TokenType::String )
+                return false;
+
+            const auto value = tokenizer.Next();
+            if ( value.type == TokenType::String )
+            {
+                if ( SappKeyValuesTokenizer::KeyEquals( key.text, "SizeOnDisk" ) )
+                    Number( value.text, sizeOnDisk );
+                else if ( SappKeyValuesTokenizer::KeyEquals( key.text, "NeedsUpdate" ) )
+                    needsUpdate = value.text != "0";
+                else if ( SappKeyValuesTokenizer::KeyEquals( key.text, "NeedsDownload" ) )
+                    needsDownload = value.text != "0";
+                continue;
+            }
+            if ( value.type != TokenType::BlockBegin )
+                return false;
+
+            const bool installed = SappKeyValuesTokenizer::KeyEquals( key.text, "WorkshopItemsInstalled" );
+            const bool details = SappKeyValuesTokenizer::KeyEquals( key.text, "WorkshopItemDetails" );
+            if ( !installed && !details )
+            {
+                if ( !tokenizer.SkipBlock() )
+                    return false;
+                continue;
+            }
+            // "<id>" { "size" "..." "timeupdated" "..." ... } per item.
+            if ( !ForEachItem( tokenizer, [&]( std::uint64_t id, std::string_view field, std::string_view text )
+            {
+                if ( details )
+                {
+                    std::uint64_t time = 0;
+                    if ( SappKeyValuesTokenizer::KeyEquals( field, "timetouched" ) && Number( text, time ) )
+                        touched.emplace_back( id, time );
+                    return;
+                }
+                if ( items.empty() || items.back().id != id )
+                {
+                    auto &item = items.emplace_back();
+                    item.id = id;
+                    item.path = folder + "content" CORRECT_PATH_SEPARATOR_S + std::to_string( appid ) + CORRECT_PATH_SEPARATOR_S + std::to_string( id );
+                }
+                if ( SappKeyValuesTokenizer::KeyEquals( field, "size" ) )
+                    Number( text, items.back().size );
+                else if ( SappKeyValuesTokenizer::KeyEquals( field, "timeupdated" ) )
+                    Number( text, items.back().timeUpdated );
+            } ) )
+                return false;
+        }
+
+        std::sort( items.begin(), items.end(), []( const auto &a, const auto &b ) { return a.id < b.id; } );
+        for ( const auto &[id, time] : touched )
+        {
+            const auto item = std::lower_bound( items.begin(), items.end(), id, []( const auto &known, std::uint64_t value ) { return known.id < value; } );
+            if ( item != items.end() && item->id == id )
+                item->timeTouched = time;
+        }
+        loaded = true;
+        return true;
+    }
+
+    // The last Load() succeeded.
+    [[nodiscard]] bool Available() const
+    {
+        return loaded;
+    }
+
+    [[nodiscard]] AppId_t GetAppId() const
+    {
+        return appid;
+    }
+
+    [[nodiscard]] const std::string &GetManifest() const
+    {
+        return manifest;
+    }
+
+    // The manifest as it was when it was loaded.
+    [[nodiscard]] const SappFileStamp &GetStamp() const
+    {
+        return stamp;
+    }
+
+    // Sorted by id.
+    [[nodiscard]] std::span<const SappWorkshopItem> GetItems() const
+    {
+        return items;
+    }
+
+    [[nodiscard]] const SappWorkshopItem *Find( std::uint64_t id ) const
+    {
+        const auto it = std::lower_bound( items.begin(), items.end(), id, []( const auto &item, std::uint64_t value ) { return item.id < value; } );
+        return it != items.end() && it->id == id ? &*it : nullptr;
+    }
+
+    // Of all items, as recorded by Steam.
+    [[nodiscard]] std::uint64_t GetSizeOnDisk() const
+    {
+        return sizeOnDisk;
+    }
+
+    [[nodiscard]] bool NeedsUpdate() const
+    {
+        return needsUpdate;
+    }
+
+    [[nodiscard]] bool NeedsDownload() const
+    {
+        return needsDownload;
+    }
+
+    // Whether the manifest changed since it was loaded; a stat.
+    [[nodiscard]] bool IsStale() const
+    {
+        return SappFileStamp::Of( manifest ) != stamp;
+    }
+
+private:
+    static bool Number( std::string_view text, std::uint64_t &out )
+    {
+        const auto result = std::from_chars( text.data(), text.data() + text.size(), out );
+        return result.ec == std::errc() && !text.empty();
+    }
+
+    // Calls visit( id, key, value ) for the values of every "<id>" { ... } block until the
+    // enclosing block ends. Blocks nested inside an item are skipped.
+    template<typename Visit>
+    static bool ForEachItem( SappKeyValuesTokenizer &tokenizer, Visit &&visit )
+    {
+        using TokenType = SappKeyValuesTokenizer::TokenType;
+        while ( true )
+        {
+            const auto id = tokenizer.Next();
+            if ( id.type == TokenType::BlockEnd )
+                return true;
+            if ( id.type != TokenType::String || tokenizer.Next().type != TokenType::BlockBegin )
+                return false;
+
+            std::uint64_t number = 0;
+            const bool valid = Number( id.text, number );
+            while ( true )
+            {
+                const auto key = tokenizer.Next();
+                if ( key.type == TokenType::BlockEnd )
+                    break;
+                if ( key.type != TokenType::String )
+                    return false;
+
+                const auto value = tokenizer.Next();
+                if ( value.type == TokenType::BlockBegin )
+                {
+                    if ( !tokenizer.SkipBlock() )
+                        return false;
+                    continue;
+                }
+                if ( value.type != TokenType::String )
+                    return false;
+                if ( valid )
+                    visit( number, key.text, value.text );
+            }
+        }
+    }
+
+    AppId_t appid = k_uAppIdInvalid;
+    std::string manifest;
+    SappFileStamp stamp;
+    std::vector<SappWorkshopItem> items;
+    std::uint64_t sizeOnDisk = 0;
+    bool needsUpdate = false;
+    bool needsDownload = false;
+    bool loaded = false;
+};
+
+// An app with a folder in a library's downloading folder, which Steam fills while an install or
+// update is downloaded and empties once it is applied.
+struct SappDownloadingApp
+{
+    AppId_t appid = k_uAppIdInvalid;
+    // <library>/downloading/<appid>
+    std::string path;
+};
+
+struct SappAppChange
+{
+    enum class Type
+    {
+        Installed,
+        Updated,
+        Removed
+    };
+
+    Type type;
+    AppId_t appid;
+};
+
+// Thin inotify wrapper reporting create/write/move/delete events for a set of directories.
+// Only available on Linux, elsewhere Add() always fails.
+class SappDirectoryWatcher
+{
+public:
+    SappDirectoryWatcher()
+    {
+#ifdef __linux__
+        fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+#endif
+    }
+
+    ~SappDirectoryWatcher()
+    {
+#ifdef __linux__
+        if ( fd >= 0 )
+            ::close( fd );
+#endif
+    }
+
+    SappDirectoryWatcher( const SappDirectoryWatcher & ) = delete;
+    SappDirectoryWatcher &operator=( const SappDirectoryWatcher & ) = delete;
+
+    [[nodiscard]] bool IsValid() const
+    {
+        return fd >= 0;
+    }
+
+    [[nodiscard]] int Descriptor() const
+    {
+        return fd;
+    }
+
+    // Returns the watch descriptor, or -1.
+    int Add( const std::string &directory )
+    {
+#ifdef __linux__
+        if ( fd < 0 )
+            return -1;
+        return inotify_add_watch( fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR );
+#else
+        return -1;
+#endif
+    }
+
+    void Remove( int watch )
+    {
+#ifdef __linux__
+        if ( fd >= 0 && watch >= 0 )
+            inotify_rm_watch( fd, watch );
+#endif
+    }
+
+    // Waits up to timeoutMs (0 = don't wait, -1 = forever) and calls handler( watch, name ) for every
+    // pending event. handler( -1, {} ) means the kernel queue overflowed and events were lost.
+    template<typename Handler>
+    std::size_t Drain( int timeoutMs, Handler &&handler )
+    {
+        std::size_t count = 0;
+#ifdef __linux__
+        if ( fd < 0 )
+            return 0;
+
+        if ( timeoutMs != 0 )
+        {
+            pollfd pfd{ fd, POLLIN, 0 };
+            if ( poll( &pfd, 1, timeoutMs ) <= 0 )
+                return 0;
+        }
+
+        alignas( inotify_event ) char buffer[SAPP_MAX_PATH * 4];
+        while ( true )
+        {
+            const auto length = read( fd, buffer, sizeof( buffer ) );
+            if ( length <= 0 )
+                break;
+
+            for ( const char *p = buffer; p < buffer + length; )
+            {
+                const auto event = reinterpret_cast<const inotify_event *>( p );
+                if ( event->mask & IN_Q_OVERFLOW )
+                    handler( -1, std::string_view{} );
+                else if ( event->len > 0 )
+                    handler( event->wd, std::string_view( event->name ) );
+                count++;
+                p += sizeof( inotify_event ) + event->len;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd = -1;
+};
+
+class SteamAppPathProvider;
+class SappAsyncScan;
+template<SappManifestField... Fields>
+class SappManifestTable;
+
+class ISteamSearchProvider
+{
+
+protected:
+    static auto SappFileHelper( const std::string &path ) -> SappMappedFile
+    {
+        return SappMappedFile( path );
+    }
+
+
+public:
+    virtual ~ISteamSearchProvider() = default;
+
+    // The arena-backed form of a game that snapshots keep. Its strings are owned by the snapshot it
+    // came from and stay valid for as long as that is held. Opt in through GetSnapshot().
+    class GameView
+    {
+
+        friend SteamAppPathProvider; 
+
+    public:
+
+        GameView( std::string_view vGameName, std::string_view vLibrary, std::string_view vInstallDir, std::string_view vLibraryCache, AppId_t vAppid, std::string_view vInstallPath = {}, uint32 vRoot = 0 )
+            : gameName( vGameName ), library( vLibrary ), installDir( vInstallDir ), libraryCache( vLibraryCache ), installPath( vInstallPath ), appid( vAppid ), root( vRoot )
+        {
+        }
+
+        [[nodiscard]] std::string_view GetName() const
+        {
+            return gameName;
+        }
+
+        [[nodiscard]] std::string_view GetLibrary() const
+        {
+            return library;
+        }
+
+        [[nodiscard]] std::string_view GetInstallDir() const
+        {
+            return installDir;
+        }
+
+        // <library>/common/<installDir>, what GetAppInstallDir() appends.
+        [[nodiscard]] std::string_view GetInstallPath() const
+        {
+            return installPath;
+        }
+
+        // Index of the Steam install the game was found through, see SappSnapshot::GetSteamRoots().
+        // A library shared by several installs belongs to the first of them.
+        [[nodiscard]] uint32 GetRoot() const
+        {
+            return root;
+        }
+
+        // <steam>/appcache/librarycache/<appid>_icon.jpg, built on request.
+        [[nodiscard]] std::string GetIcon() const
+        {
+            if ( libraryCache.empty() )
+                return {};
+            std::string icon;
+            icon.reserve( libraryCache.size() + 20 );
+            icon.append( libraryCache );
+            icon.append( std::to_string( appid ) );
+            icon.append( "_icon.jpg" );
+            return icon;
+        }
+
+        std::string_view gameName;
+        // The library's steamapps folder, shared by every game of that library.
+        std::string_view library;
+        std::string_view installDir;
+        std::string_view libraryCache;
+        std::string_view installPath;
+        AppId_t appid;
+        uint32 root;
+    };
+
+    // A game that owns its strings, what the provider's getters return.
+    class Game
+    {
+
+        friend SteamAppPathProvider; 
+
+    public:
+
+        Game( std::string_view vGameName, std::string_view vLibrary, std::string_view vInstallDir, std::string_view vIcon, AppId_t vAppid )
+            : gameName( vGameName ), library( vLibrary ), installDir( vInstallDir ), icon( vIcon ), appid( vAppid )
+        {
+        }
+
+        explicit Game( const GameView &view )
+            : gameName( view.GetName() ), library( view.GetLibrary() ), installDir( view.GetInstallDir() ), icon( view.GetIcon() ),
+              installPath( view.GetInstallPath() ), appid( view.appid ), root( view.GetRoot() )
+        {
+        }
+
+        [[nodiscard]] std::string_view GetName() const
+        {
+            return gameName;
+        }
+
+        [[nodiscard]] std::string_view GetLibrary() const
+        {
+            return library;
+        }
+
+        [[nodiscard]] std::string_view GetInstallDir() const
+        {
+            return installDir;
+        }
+
+        [[nodiscard]] std::string_view GetInstallPath() const
+        {
+            return installPath;
+        }
+
+        [[nodiscard]] uint32 GetRoot() const
+        {
+            return root;
+        }
+
+        [[nodiscard]] std::string_view GetIcon() const
+        {
+            return icon;
+        }
+
+        std::string gameName;
+        std::string library;
+        std::string installDir;
+        std::string icon;
+        std::string installPath;
+        AppId_t appid;
+        uint32 root = 0;
+    };
+
+    [[nodiscard]] virtual bool Available() const = 0;
+
+    [[nodiscard]] virtual bool BIsAppInstalled( AppId_t appID ) const = 0;
+
+    [[nodiscard]] virtual uint32 GetNumInstalledApps() const = 0;
+
+    [[nodiscard]] virtual bool BIsSourceGame( AppId_t appID ) const = 0;
+
+    [[nodiscard]] virtual bool BIsSource2Game( AppId_t appID ) const = 0;
+
+    virtual uint32 GetInstalledApps(AppId_t *appids, uint32 unMaxAppIDs ) const = 0;
+
+    virtual void sortGames(bool toGreater) = 0;
+
+    [[nodiscard]] virtual AppId_t *GetInstalledAppsEX() const = 0;
+
+    virtual bool GetAppInstallDir(AppId_t appID, std::string &pchFolder, int pFileSize = 0) const = 0;
+
+    // Returns a Game with appid k_uAppIdInvalid when the app is not installed.
+    // Breaking change: this used to return const Game &, overrides have to be updated. The game list
+    // is replaced by PollChanges() and Refresh() at any time, so there is nothing a reference could
+    // stay valid in. Every call copies the strings out of the current snapshot; in hot loops hold
+    // one SteamAppPathProvider::GetSnapshot() and call its GetAppInstallDirEX(), which returns a
+    // reference valid for as long as the snapshot is held.
+    [[nodiscard]] virtual Game GetAppInstallDirEX(AppId_t appID ) const = 0;
+
+};
+
+// Publishes a shared_ptr to any number of readers without them ever waiting. A reader counts
+// itself in one of two counters, picked by the epoch, while it copies the pointer. A writer swaps
+// the pointer, then flips the epoch twice. After each flip it waits for the counter that new
+// readers no longer use to drain. Only then is the previous pointer released, because no reader
+// can still be copying it.
+template<typename T>
+class SappRcuCell
+{
+public:
+    explicit SappRcuCell( std::shared_ptr<const T> initial )
+        : current( new std::shared_ptr<const T>( std::move( initial ) ) )
+    {
+    }
+
+    ~SappRcuCell()
+    {
+        delete current.load( std::memory_order_relaxed );
+    }
+
+    SappRcuCell( const SappRcuCell & ) = delete;
+    SappRcuCell &operator=( const SappRcuCell & ) = delete;
+
+    [[nodiscard]] std::shared_ptr<const T> Load() const
+    {
+        auto &readers = readerCounts[epoch.load( std::memory_order_seq_cst ) & 1].count;
+        readers.fetch_add( 1, std::memory_order_seq_cst );
+        std::shared_ptr<const T> value = *current.load( std::memory_order_seq_cst );
+        readers.fetch_sub( 1, std::memory_order_release );
+        return value;
+    }
+
+    // Writers have to be serialized by the caller.
+    void Store( std::shared_ptr<const T> value )
+    {
+        const auto previous = current.exchange( new std::shared_ptr<const T>( std::move( value ) ), std::memory_order_seq_cst );
+        for ( int flip = 0; flip < 2; flip++ )
+        {
+            // Dekker style: a reader stores its count then loads current, the writer stores current
+            // then loads the count. Only seq_cst on both loads rules out each missing the other's
+            // store, an acquire load here may see 0 while a reader still copies the old pointer.
+            const auto &readers = readerCounts[epoch.fetch_add( 1, std::memory_order_seq_cst ) & 1].count;
+            while ( readers.load( std::memory_order_seq_cst ) != 0 )
+                std::this_thread::yield();
+        }
+        delete previous;
+    }
+
+private:
+    struct alignas( 64 ) ReaderCount
+    {
+        std::atomic<std::size_t> count{ 0 };
+    };
+
+    std::atomic<const std::shared_ptr<const T> *> current;
+    alignas( 64 ) std::atomic<std::size_t> epoch{ 0 };
+    mutable ReaderCount readerCounts[2];
+};
+
+// Orders SappSnapshot::GetOrder() can hand out. Ties are broken by appid.
+enum class SappSortKey
+{
+    AppId,
+    // Case-insensitive.
+    Name,
+    // Library path, then name.
+    Library,
+    // SizeOnDisk of the manifest, whatever the StateFlags.
+    Size,
+};
+
+// One generation of a provider's game list: the games, the arena holding their strings, the appid
+// index and the engine sets. It isn't changed after being published, apart from lazily detected
+// engine flags which are atomic, so any number of threads can read it without locking, and all
+// it hands out stays valid for as long as the snapshot is held.
+class SappSnapshot
+{
+    friend SteamAppPathProvider;
+
+public:
+    using GameView = ISteamSearchProvider::GameView;
+
+    [[nodiscard]] bool Available() const
+    {
+        return !games.empty();
+    }
+
+    [[nodiscard]] bool BIsSourceGame( AppId_t appID ) const
+    {
+        if(precacheSourceGames)
+            return appIndex.Flags( appID ) & PrecachedSource;
+
+        if ( lazyEngineDetection )
+            return LazyEngineState( appID ) & EngineSource;
+
+        if ( !BIsAppInstalled( appID ) )
+            return false;
+
+        std::string dirPath{};
+        dirPath.reserve(SAPP_MAX_PATH);
+        GetAppInstallDir(appID, dirPath);
+
+        return SappEngineProbe::Probe( dirPath, true, false ) & SappEngineProbe::Source;
+    }
+
+    [[nodiscard]] bool BIsSource2Game( AppId_t appID ) const
+    {
+        if(precacheSource2Games)
+            return appIndex.Flags( appID ) & PrecachedSource2;
+
+        if ( lazyEngineDetection )
+            return LazyEngineState( appID ) & EngineSource2;
+
+        if ( !BIsAppInstalled( appID ) )
+            return false;
+
+        std::string dirPath{};
+        dirPath.reserve(SAPP_MAX_PATH);
+        GetAppInstallDir(appID, dirPath);
+
+        return SappEngineProbe::Probe( dirPath, false, true ) & SappEngineProbe::Source2;
+    }
+
+    [[nodiscard]] bool BIsAppInstalled( AppId_t appID ) const
+    {
+        return appIndex.Find( appID ) != SappAppIdIndex::npos;
+    }
+
+    bool GetAppInstallDir( AppId_t appID, std::string &directory ) const
+    {
+        const auto index = appIndex.Find( appID );
+        if ( index == SappAppIdIndex::npos )
+            return false;
+
+        directory.append( games[index].installPath );
+        return true;
+    }
+
+    // Resolves many install folders at once. The paths are written back to back into buffer, the one
+    // of appids[i] is buffer[offsets[i], offsets[i + 1]), which is empty when found[i] is false.
+    // offsets needs appids.size() + 1 entries and found appids.size(). Returns the number of bytes the
+    // paths take; if that is more than buffer.size(), the buffer holds only those that fit, the
+    // offsets and found flags are complete regardless.
+    std::size_t GetAppInstallDirs( std::span<const AppId_t> appIds, std::span<char> buffer, std::span<uint32> offsets, std::span<bool> found ) const
+    {
+        std::size_t size = 0;
+        for ( std::size_t i = 0; i < appIds.size(); i++ )
+        {
+            offsets[i] = static_cast<uint32>( size );
+            const auto index = appIndex.Find( appIds[i] );
+            found[i] = index != SappAppIdIndex::npos;
+            if ( !found[i] )
+                continue;
+
+            const auto path = games[index].installPath;
+            if ( size + path.size() <= buffer.size() )
+                std::memcpy( buffer.data() + size, path.data(), path.size() );
+            size += path.size();
+        }
+        offsets[appIds.size()] = static_cast<uint32>( size );
+        return size;
+    }
+
+    // Returns a Game with appid k_uAppIdInvalid when the app is not installed.
+    [[nodiscard]] const GameView &GetAppInstallDirEX( AppId_t appID ) const
+    {
+        static const GameView notInstalled{ "", "", "", "", k_uAppIdInvalid };
+
+        const auto index = appIndex.Find( appID );
+        if ( index == SappAppIdIndex::npos )
+            return notInstalled;
+
+        return games[index];
+    }
+
+    // The gameinfo.txt / gameinfo.gi files of an installed app, sorted: <install>/<mod>/gameinfo.txt
+    // for Source and <install>/<dir>/gameinfo.gi or <install>/<dir>/<mod>/gameinfo.gi for Source 2,
+    // the same places BIsSourceGame / BIsSource2Game look.
+    [[nodiscard]] std::vector<std::string> GetGameInfoFiles( AppId_t appID ) const
+    {
+        std::vector<std::string> files;
+        std::string installDir;
+        if ( !GetAppInstallDir( appID, installDir ) )
+            return files;
+
+        std::error_code ec;
+        for ( const auto &entry : fs::directory_iterator( installDir, fs::directory_options::skip_permission_denied, ec ) )
+        {
+            if ( !entry.is_directory( ec ) )
+                continue;
+            for ( const auto name : { "gameinfo.txt", "gameinfo.gi" } )
+            {
+                if ( fs::exists( entry.path() / name, ec ) )
+                    files.push_back( ( entry.path() / name ).string() );
+            }
+            for ( const auto &sub : fs::directory_iterator( entry.path(), fs::directory_options::skip_permission_denied, ec ) )
+            {
+                if ( sub.is_directory( ec ) && fs::exists( sub.path() / "gameinfo.gi", ec ) )
+                    files.push_back( ( sub.path() / "gameinfo.gi" ).string() );
+            }
+        }
+        std::sort( files.begin(), files.end() );
+        return files;
+    }
+
+    // Loads the gameinfo of the mod folder mod ("hl2", "csgo", ...), or of the first of
+    // GetGameInfoFiles() when mod is empty.
+    [[nodiscard]] std::optional<SappGameInfo> GetGameInfo( AppId_t appID, std::string_view mod = {} ) const
+    {
+        for ( const auto &file : GetGameInfoFiles( appID ) )
+        {
+            if ( !mod.empty() && fs::path( file ).parent_path().filename() != mod )
+                continue;
+            SappGameInfo info;
+            if ( info.Load( file ) )
+                return info;
+        }
+        return std::nullopt;
+    }
+
+    // The manifest's SizeOnDisk when options.trustManifest and it can be trusted, the size of the
+    // install folder otherwise. nullopt when the app isn't installed.
+    [[nodiscard]] std::optional<SappInstallSize> GetAppInstallSize( AppId_t appID, const SappDiskUsageOptions &options = {} ) const
+    {
+        const auto index = appIndex.Find( appID );
+        if ( index == SappAppIdIndex::npos )
+            return std::nullopt;
+        return MeasureInstalls( std::span<const GameView>( &games[index], 1 ), options ).apps.front();
+    }
+
+    // The install size of every game and their sums per library. The installs that have to be
+    // walked are walked together, sharing options.maxConcurrency threads.
+    [[nodiscard]] SappDiskUsageReport GetDiskUsage( const SappDiskUsageOptions &options = {} ) const
+    {
+        return MeasureInstalls( GetGames(), options );
+    }
+
+    // The workshop items of an installed app, read on first use and again once its workshop
+    // manifest changed, which costs a stat per call. Nothing is read for apps that are never asked
+    // about. nullptr when the app isn't installed or has no readable workshop manifest.
+    [[nodiscard]] std::shared_ptr<const SappWorkshopContent> GetWorkshopContent( AppId_t appID ) const
+    {
+        const auto index = appIndex.Find( appID );
+        if ( index == SappAppIdIndex::npos )
+            return nullptr;
+
+        const auto library = games[index].library;
+        std::shared_ptr<const SappWorkshopContent> content;
+        {
+            std::scoped_lock lock( workshop->lock );
+            const auto cached = workshop->contents.find( appID );
+            if ( cached != workshop->contents.end() )
+                content = cached->second;
+        }
+        // The cache is shared with older snapshots, which may have had the app in another library.
+        const auto inLibrary = [library]( const SappWorkshopContent &cached )
+        {
+            const auto &manifest = cached.GetManifest();
+            return manifest.size() > library.size() && manifest.starts_with( library ) && manifest[library.size()] == CORRECT_PATH_SEPARATOR;
+        };
+        if ( !content || content->IsStale() || !inLibrary( *content ) )
+        {
+            // Racing readers may both load it; either result is current, so that's harmless.
+            auto loaded = std::make_shared<SappWorkshopContent>();
+            loaded->Load( appID, library );
+            content = std::move( loaded );
+            std::scoped_lock lock( workshop->lock );
+            workshop->contents[appID] = content;
+        }
+        return content->Available() ? content : nullptr;
+    }
+
+    // GetWorkshopContent() of several apps, read on workerCount threads (0 = one per hardware
+    // thread). In appIds order.
+    [[nodiscard]] std::vector<std::shared_ptr<const SappWorkshopContent>> GetWorkshopContent( std::span<const AppId_t> appIds, unsigned int workerCount = 0 ) const
+    {
+        std::vector<std::shared_ptr<const SappWorkshopContent>> contents( appIds.size() );
+        SappWorkStealingPool::Run( appIds.size(), workerCount, [&]( std::size_t index, unsigned int )
+        {
+            contents[index] = GetWorkshopContent( appIds[index] );
+        } );
+        return contents;
+    }
+
+    // Bytes held for the game list: the Game records plus the string arena behind them.
+    [[nodiscard]] std::size_t GetStorageBytes() const
+    {
+        return games.CapacityBytes() + appids.CapacityBytes() + lowerNames.CapacityBytes() + arenaBytes;
+    }
+
+    [[nodiscard]] uint32 GetNumInstalledApps() const
+    {
+        return games.size();
+    }
+
+    uint32 GetInstalledApps( AppId_t *pvecAppID, uint32 unMaxAppIDs ) const
+    {
+        const auto count = std::min<std::size_t>( unMaxAppIDs, appids.size() );
+        std::size_t copied = 0;
+        appids.ForEachChunk( [&]( std::span<const AppId_t> chunk )
+        {
+            const auto size = std::min( chunk.size(), count - copied );
+            if ( size )
+                std::memcpy( pvecAppID + copied, chunk.data(), size * sizeof( AppId_t ) );
+            copied += size;
+        } );
+        return static_cast<uint32>( count );
+    }
+
+    // The app whose install folder holds path, k_uAppIdInvalid if none does. path has to be
+    // absolute and lexically normal; it may go through the library either as listed by Steam or
+    // with its symlinks resolved. Takes two searches of sorted blocks, no allocation.
+    [[nodiscard]] AppId_t FindAppByPath( std::string_view path ) const
+    {
+        if ( path.size() >= SAPP_MAX_PATH )
+            return k_uAppIdInvalid;
+
+        // Every key ends with a separator, so does the query; the install folder itself matches too.
+        char buffer[SAPP_MAX_PATH + 1];
+        std::memcpy( buffer, path.data(), path.size() );
+        auto size = path.size();
+        if ( !size || buffer[size - 1] != CORRECT_PATH_SEPARATOR )
+            buffer[size++] = CORRECT_PATH_SEPARATOR;
+        const std::string_view query( buffer, size );
+
+        const auto library = FindPathPrefix( libraryPrefixes, query );
+        if ( !library )
+            return k_uAppIdInvalid;
+        const auto installDir = FindPathPrefix( installDirKeys[library->value], query.substr( library->key.size() ) );
+        return installDir ? installDir->value : k_uAppIdInvalid;
+    }
+
+    // Installed apps whose name contains query, ignoring ASCII case, best matches first: the whole
+    // name, then names starting with it, then names with a word starting with it, then any other
+    // names holding it. Ties are in name order. Queries shorter than three characters only match
+    // at the start of a name or word. maxResults 0 returns every match.
+    [[nodiscard]] std::vector<AppId_t> FindAppsByName( std::string_view query, std::size_t maxResults = 0 ) const
+    {
+        std::vector<AppId_t> results;
+        if ( query.empty() )
+            return results;
+
+        std::string lowered( query );
+        for ( auto &c : lowered )
+            c = LowerAscii( c );
+
+        enum : uint32 { Exact, Prefix, WordPrefix, Substring };
+        // ( rank, game )
+        std::vector<std::pair<uint32, uint32>> matches;
+        const auto add = [&]( uint32 rank, AppId_t appid ) { matches.emplace_back( rank, appIndex.Find( appid ) ); };
+
+        const auto byName = [this]( uint32 a, uint32 b ) { return LowerName( a ) < LowerName( b ); };
+        const auto before = []( const NameKey &key, const std::string &value ) { return key.text < value; };
+        for ( auto it = nameOrder.LowerBound( lowered, before ); it != nameOrder.end() && it->text.starts_with( lowered ); ++it )
+            add( it->text.size() == lowered.size() ? Exact : Prefix, it->appid );
+
+        for ( auto it = wordStarts.LowerBound( lowered, before ); it != wordStarts.end() && it->text.starts_with( lowered ); ++it )
+            add( WordPrefix, it->appid );
+
+        if ( lowered.size() >= 3 )
+        {
+            // Only names holding the query's rarest trigram are looked at.
+            TrigramPostings candidates;
+            std::size_t candidateCount = 0;
+            for ( std::size_t i = 0; i + 3 <= lowered.size(); i++ )
+            {
+                const auto postings = Postings( Trigram( lowered.data() + i ) );
+                const auto count = postings.first.DistanceTo( postings.second );
+                if ( i == 0 || count < candidateCount )
+                {
+                    candidates = postings;
+                    candidateCount = count;
+                }
+                if ( !count )
+                    break;
+            }
+            for ( auto it = candidates.first; candidateCount && it != candidates.second; ++it )
+            {
+                const auto game = appIndex.Find( it->second );
+                if ( LowerName( game ).find( lowered ) != std::string_view::npos )
+                    matches.emplace_back( Substring, game );
+            }
+        }
+
+        // Best rank per game, then by rank and name.
+        std::sort( matches.begin(), matches.end(), []( const auto &a, const auto &b ) { return a.second != b.second ? a.second < b.second : a.first < b.first; } );
+        matches.erase( std::unique( matches.begin(), matches.end(), []( const auto &a, const auto &b ) { return a.second == b.second; } ), matches.end() );
+        std::sort( matches.begin(), matches.end(), [&]( const auto &a, const auto &b ) { return a.first != b.first ? a.first < b.first : byName( a.second, b.second ); } );
+
+        const auto count = maxResults ? std::min( maxResults, matches.size() ) : matches.size();
+        results.reserve( count );
+        for ( std::size_t i = 0; i < count; i++ )
+            results.push_back( games[matches[i].second].appid );
+        return results;
+    }
+
+    // The appids of all games, contiguous and in game list order. The snapshot keeps its games in
+    // blocks it shares with the next one, so they are gathered into one array on first use.
+    [[nodiscard]] std::span<const AppId_t> GetAppIds() const
+    {
+        std::call_once( flat.appidsOnce, [&]
+        {
+            flat.appids.reserve( appids.size() );
+            appids.ForEachChunk( [&]( std::span<const AppId_t> chunk ) { flat.appids.insert( flat.appids.end(), chunk.begin(), chunk.end() ); } );
+        } );
+        return flat.appids;
+    }
+
+    // Gathered on first use like GetAppIds().
+    [[nodiscard]] std::span<const GameView> GetGames() const
+    {
+        std::call_once( flat.gamesOnce, [&]
+        {
+            flat.games.reserve( games.size() );
+            games.ForEachChunk( [&]( std::span<const GameView> chunk ) { flat.games.insert( flat.games.end(), chunk.begin(), chunk.end() ); } );
+        } );
+        return flat.games;
+    }
+
+    // Indices into GetGames() in key order, computed on first use and kept with the snapshot, so
+    // orderings are shared by every reader and only rebuilt when a change publishes a new one.
+    [[nodiscard]] std::span<const uint32> GetOrder( SappSortKey key ) const
+    {
+        auto &order = orders.Of( key );
+        std::call_once( order.once, [&]
+        {
+            order.indices = BuildOrder( key );
+            order.ready.store( true, std::memory_order_release );
+        } );
+        return order.indices;
+    }
+
+    // The games in key order without copying or moving them; reverse it for descending order.
+    [[nodiscard]] auto GetGamesBy( SappSortKey key ) const
+    {
+        return GetOrder( key ) | std::views::transform( [flat = GetGames()]( uint32 index ) -> const GameView & { return flat[index]; } );
+    }
+
+    // Every Steam install that was scanned (native, Flatpak, Snap, ...), indexed by Game::GetRoot().
+    [[nodiscard]] std::span<const std::string_view> GetSteamRoots() const
+    {
+        return steamRoots;
+    }
+
+    // Every library folder of those installs, in scan order.
+    [[nodiscard]] std::span<const std::string_view> GetLibraryPaths() const
+    {
+        return libraryPaths;
+    }
+
+    // Lazily filtered views of GetGames(), nothing is copied. Engine filters cost what
+    // BIsSourceGame / BIsSource2Game cost for every game they step over.
+    [[nodiscard]] auto GetSourceGames() const
+    {
+        return GetGames() | std::views::filter( [this]( const GameView &game ) { return BIsSourceGame( game.appid ); } );
+    }
+
+    [[nodiscard]] auto GetSource2Games() const
+    {
+        return GetGames() | std::views::filter( [this]( const GameView &game ) { return BIsSource2Game( game.appid ); } );
+    }
+
+    // library is a steamapps folder, as returned by Game::GetLibrary().
+    [[nodiscard]] auto GetGamesInLibrary( std::string_view library ) const
+    {
+        return GetGames() | std::views::filter( [library]( const GameView &game ) { return game.library == library; } );
+    }
+
+private:
+    enum LazyEngineFlags : std::uint8_t
+    {
+        EngineClassified = 1 << 0,
+        EngineSource = 1 << 1,
+        EngineSource2 = 1 << 2,
+    };
+
+    // SappAppIdIndex::Flags(), for the engines precached by the scan.
+    enum PrecachedEngineFlags : std::uint8_t
+    {
+        PrecachedSource = 1 << 0,
+        PrecachedSource2 = 1 << 1,
+    };
+
+    static SappDiskUsageReport MeasureInstalls( std::span<const GameView> measured, const SappDiskUsageOptions &options )
+    {
+        SappDiskUsageReport report;
+        report.apps.resize( measured.size() );
+        std::vector<std::string> walked;
+        std::vector<std::size_t> walkedApps;
+        for ( std::size_t i = 0; i < measured.size(); i++ )
+        {
+            const auto &game = measured[i];
+            auto &size = report.apps[i];
+            size.appid = game.appid;
+
+            const auto library = std::find_if( report.libraries.begin(), report.libraries.end(), [&]( const auto &known ) { return known.path == game.library; } );
+            size.library = static_cast<uint32>( library - report.libraries.begin() );
+            if ( library == report.libraries.end() )
+                report.libraries.push_back( { std::string( game.library ) } );
+
+            if ( options.trustManifest && ReadManifestSize( game, size.bytes ) )
+            {
+                size.fromManifest = true;
+                continue;
+            }
+            walked.emplace_back( game.installPath );
+            walkedApps.push_back( i );
+        }
+
+        const auto usage = SappDiskUsage::Measure( walked, options );
+        for ( std::size_t i = 0; i < usage.size(); i++ )
+        {
+            auto &size = report.apps[walkedApps[i]];
+            size.bytes = usage[i].bytes;
+            size.files = usage[i].files;
+            size.complete = usage[i].complete;
+        }
+
+        for ( const auto &size : report.apps )
+        {
+            report.libraries[size.library].bytes += size.bytes;
+            report.libraries[size.library].apps++;
+            report.complete &= size.complete;
+        }
+        return report;
+    }
+
+    // Filled in lazily by const readers, see GetWorkshopContent(). Shared by a snapshot and those
+    // derived from it, what was read is checked against the manifests on use anyway.
+    class WorkshopCache
+    {
+    public:
+        mutable std::mutex lock;
+        std::unordered_map<AppId_t, std::shared_ptr<const SappWorkshopContent>> contents;
+    };
+
+    // Filled in lazily by const readers, see GetGames() and GetAppIds(). Copies start out empty.
+    class FlatCache
+    {
+    public:
+        FlatCache() = default;
+
+        FlatCache( const FlatCache & )
+        {
+        }
+
+        FlatCache &operator=( const FlatCache & ) = delete;
+
+        mutable std::once_flag gamesOnce;
+        mutable std::vector<GameView> games;
+        mutable std::once_flag appidsOnce;
+        mutable std::vector<AppId_t> appids;
+    };
+
+    // Filled in lazily by const readers, see GetOrder(). Copies start out empty.
+    class OrderCache
+    {
+    public:
+        struct Order
+        {
+            std::once_flag once;
+            std::vector<uint32> indices;
+            // Set once indices is complete.
+            std::atomic<bool> ready{ false };
+        };
+
+        OrderCache() = default;
+
+        OrderCache( const OrderCache & )
+        {
+        }
+
+        OrderCache &operator=( const OrderCache & ) = delete;
+
+        [[nodiscard]] Order &Of( SappSortKey key ) const
+        {
+            return orders[static_cast<std::size_t>( key )];
+        }
+
+    private:
+        mutable std::array<Order, 4> orders;
+    };
+
+    [[nodiscard]] std::vector<uint32> BuildOrder( SappSortKey key ) const
+    {
+        std::vector<uint32> indices( games.size() );
+        std::iota( indices.begin(), indices.end(), 0u );
+        auto lessName = []( std::string_view left, std::string_view right )
+        {
+            return std::lexicographical_compare( left.begin(), left.end(), right.begin(), right.end(), []( char a, char b )
+            {
+                return SappKeyValuesTokenizer::ToLower( a ) < SappKeyValuesTokenizer::ToLower( b );
+            } );
+        };
+        auto byKey = [&]( auto &&keyOf )
+        {
+            std::sort( indices.begin(), indices.end(), [&]( uint32 left, uint32 right )
+            {
+                return std::tuple( keyOf( left ), games[left].appid ) < std::tuple( keyOf( right ), games[right].appid );
+            } );
+        };
+
+        switch ( key )
+        {
+            case SappSortKey::AppId:
+                byKey( []( uint32 ) { return 0; } );
+                break;
+            case SappSortKey::Name:
+            case SappSortKey::Library:
+                std::sort( indices.begin(), indices.end(), [&]( uint32 left, uint32 right )
+                {
+                    const auto &a = games[left];
+                    const auto &b = games[right];
+                    if ( key == SappSortKey::Library && a.library != b.library )
+                        return a.library < b.library;
+                    if ( lessName( a.gameName, b.gameName ) )
+                        return true;
+                    if ( lessName( b.gameName, a.gameName ) )
+                        return false;
+                    return a.appid < b.appid;
+                } );
+                break;
+            case SappSortKey::Size:
+            {
+                std::vector<std::uint64_t> sizes( games.size() );
+                SappWorkStealingPool::Run( games.size(), 0, [&]( std::size_t index, unsigned int )
+                {
+                    ReadManifestSize( games[index], sizes[index], false );
+                } );
+                byKey( [&]( uint32 index ) { return sizes[index]; } );
+                break;
+            }
+        }
+        return indices;
+    }
+
+    // SizeOnDisk is only current once Steam marks the app fully installed and nothing else (4);
+    // during downloads, updates or validation it lags behind the folder.
+    static bool ReadManifestSize( const GameView &game, std::uint64_t &bytes, bool fullyInstalledOnly = true )
+    {
+        using SizeParser = SappManifestParser<SappManifestField::SizeOnDisk, SappManifestField::StateFlags>;
+        std::string file( game.library );
+        file.append( CORRECT_PATH_SEPARATOR_S "appmanifest_" );
+        file.append( std::to_string( game.appid ) );
+        file.append( ".acf" );
+
+        const SappMappedFile manifest( file );
+        SizeParser::Record record;
+        const auto parsed = manifest.IsOpen() ? SizeParser::Parse( manifest.View(), record ) : 0;
+        if ( !( parsed & SizeParser::Bit<SappManifestField::SizeOnDisk> ) )
+            return false;
+        if ( fullyInstalledOnly && ( !( parsed & SizeParser::Bit<SappManifestField::StateFlags> ) || record.Get<SappManifestField::StateFlags>() != 4 ) )
+            return false;
+        bytes = record.Get<SappManifestField::SizeOnDisk>();
+        return true;
+    }
+
+    // Racing readers may both classify the same app; they store the same answer, so that's harmless.
+    [[nodiscard]] std::uint8_t LazyEngineState( AppId_t appID ) const
+    {
+        const auto state = appIndex.EngineState( appID );
+        if ( !state )
+            return 0;
+
+        auto flags = state->load( std::memory_order_acquire );
+        if ( flags & EngineClassified )
+            return flags;
+
+        std::string dirPath{};
+        GetAppInstallDir( appID, dirPath );
+        flags = ClassifyEngines( dirPath );
+        state->store( flags, std::memory_order_release );
+        return flags;
+    }
+
+    // Answers both BIsSourceGame and BIsSource2Game with one walk of the install folder.
+    static std::uint8_t ClassifyEngines( const std::string &dirPath )
+    {
+        const auto flags = SappEngineProbe::Probe( dirPath, true, true );
+        return EngineClassified | ( ( flags & SappEngineProbe::Source ) ? EngineSource : 0 ) | ( ( flags & SappEngineProbe::Source2 ) ? EngineSource2 : 0 );
+    }
+
+    // A lower-cased name, or the rest of one from the start of a word on, in the arena.
+    struct NameKey
+    {
+        std::string_view text;
+        AppId_t appid;
+    };
+
+    struct NameLess
+    {
+        bool operator()( const NameKey &a, const NameKey &b ) const
+        {
+            return std::tie( a.text, a.appid ) < std::tie( b.text, b.appid );
+        }
+    };
+
+    // ( trigram, appid )
+    using TrigramKey = std::pair<uint32, AppId_t>;
+    using TrigramIndex = SappSortedChunks<TrigramKey, std::less<TrigramKey>>;
+    using TrigramPostings = std::pair<TrigramIndex::Iterator, TrigramIndex::Iterator>;
+
+    static char LowerAscii( char c )
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>( c - 'A' + 'a' ) : c;
+    }
+
+    static bool IsWordCharacter( char c )
+    {
+        return ( c >= 'a' && c <= 'z' ) || ( c >= '0' && c <= '9' ) || static_cast<unsigned char>( c ) >= 0x80;
+    }
+
+    static uint32 Trigram( const char *text )
+    {
+        return static_cast<uint32>( static_cast<unsigned char>( text[0] ) ) << 16 | static_cast<uint32>( static_cast<unsigned char>( text[1] ) ) << 8 | static_cast<unsigned char>( text[2] );
+    }
+
+    [[nodiscard]] std::string_view LowerName( uint32 game ) const
+    {
+        return lowerNames[game];
+    }
+
+    [[nodiscard]] TrigramPostings Postings( uint32 trigram ) const
+    {
+        return { trigrams.LowerBound( trigram, []( const TrigramKey &key, uint32 value ) { return key.first < value; } ),
+                 trigrams.UpperBound( trigram, []( uint32 value, const TrigramKey &key ) { return value < key.first; } ) };
+    }
+
+    // name's words but the first, and its trigrams without repeats.
+    template<typename Word, typename Gram>
+    static void ForEachNameKey( std::string_view name, Word &&word, Gram &&trigram )
+    {
+        for ( std::size_t i = 1; i < name.size(); i++ )
+        {
+            if ( IsWordCharacter( name[i] ) && !IsWordCharacter( name[i - 1] ) )
+                word( name.substr( i ) );
+        }
+        std::vector<uint32> grams;
+        for ( std::size_t i = 0; i + 3 <= name.size(); i++ )
+            grams.push_back( Trigram( name.data() + i ) );
+        std::sort( grams.begin(), grams.end() );
+        grams.erase( std::unique( grams.begin(), grams.end() ), grams.end() );
+        for ( const auto gram : grams )
+            trigram( gram );
+    }
+
+    // Adds game's name to the name index, or drops it again, touching only the blocks it lands in.
+    void IndexName( uint32 game )
+    {
+        const auto name = LowerName( game );
+        const auto appid = games[game].appid;
+        nameOrder.Insert( { name, appid } );
+        ForEachNameKey( name, [&]( std::string_view word ) { wordStarts.Insert( { word, appid } ); }, [&]( uint32 gram ) { trigrams.Insert( { gram, appid } ); } );
+    }
+
+    void UnindexName( uint32 game )
+    {
+        const auto name = LowerName( game );
+        const auto appid = games[game].appid;
+        nameOrder.Erase( { name, appid } );
+        ForEachNameKey( name, [&]( std::string_view word ) { wordStarts.Erase( { word, appid } ); }, [&]( uint32 gram ) { trigrams.Erase( { gram, appid } ); } );
+    }
+
+    void RebuildNameIndex()
+    {
+        std::vector<NameKey> names;
+        std::vector<NameKey> words;
+        std::vector<TrigramKey> grams;
+        names.reserve( games.size() );
+        for ( uint32 game = 0; game < games.size(); game++ )
+        {
+            const auto name = LowerName( game );
+            const auto appid = games[game].appid;
+            names.push_back( { name, appid } );
+            ForEachNameKey( name, [&]( std::string_view word ) { words.push_back( { word, appid } ); }, [&]( uint32 gram ) { grams.emplace_back( gram, appid ); } );
+        }
+        std::sort( names.begin(), names.end(), NameLess() );
+        std::sort( words.begin(), words.end(), NameLess() );
+        std::sort( grams.begin(), grams.end() );
+        nameOrder.Assign( names );
+        wordStarts.Assign( words );
+        trigrams.Assign( grams );
+    }
+
+    struct PathKey
+    {
+        std::string_view key;
+        uint32 value;
+    };
+
+    struct PathLess
+    {
+        bool operator()( const PathKey &a, const PathKey &b ) const
+        {
+            return std::tie( a.key, a.value ) < std::tie( b.key, b.value );
+        }
+    };
+
+    using PathKeys = SappSortedChunks<PathKey, PathLess>;
+
+    // The longest key that is a prefix of path, or nullptr. keys is sorted and every key, like path,
+    // ends with a separator. The closest smaller key is the answer unless it only shares a part of
+    // path, then the search is repeated for path cut back to the last separator they share.
+    static const PathKey *FindPathPrefix( const PathKeys &keys, std::string_view path )
+    {
+        while ( !path.empty() )
+        {
+            auto it = keys.UpperBound( path, []( std::string_view value, const PathKey &key ) { return value < key.key; } );
+            if ( it == keys.begin() )
+                return nullptr;
+            --it;
+            if ( path.starts_with( it->key ) )
+                return &*it;
+
+            const auto common = static_cast<std::size_t>( std::mismatch( path.begin(), path.end(), it->key.begin(), it->key.end() ).first - path.begin() );
+            const auto cut = common ? path.rfind( CORRECT_PATH_SEPARATOR, common - 1 ) : std::string_view::npos;
+            if ( cut == std::string_view::npos )
+                return nullptr;
+            path = path.substr( 0, cut + 1 );
+        }
+        return nullptr;
+    }
+
+    // Keeps lazily detected engine flags and precached engines of apps that are still present.
+    void RebuildIndex()
+    {
+        SappAppIdIndex previous = std::move( appIndex );
+        appIndex = SappAppIdIndex();
+        appIndex.Reset( games.size() );
+        for ( uint32 i = 0; i < games.size(); i++ )
+        {
+            appIndex.Insert( games[i].appid, i );
+            appIndex.SetFlags( games[i].appid, previous.Flags( games[i].appid ) );
+            if ( const auto state = previous.EngineState( games[i].appid ) )
+                appIndex.EngineState( games[i].appid )->store( state->load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        }
+    }
+
+    // Shared with the snapshots derived from this one, see SteamAppPathProvider::CopySnapshot().
+    std::shared_ptr<SappStringArena> arena = std::make_shared<SappStringArena>();
+    // The per-game lists and the indices below are kept in blocks shared with the snapshots derived
+    // from this one, a change copies only the blocks it touches.
+    SappChunkedArray<GameView> games;
+    // games[i].appid, kept apart so enumerating them copies blocks of appids only.
+    SappChunkedArray<AppId_t> appids;
+    // games[i].gameName lower-cased, in the arena.
+    SappChunkedArray<std::string_view> lowerNames;
+    std::vector<std::string_view> steamRoots;
+    std::vector<std::string_view> libraryPaths;
+    SappAppIdIndex appIndex;
+    OrderCache orders;
+    FlatCache flat;
+    std::shared_ptr<WorkshopCache> workshop = std::make_shared<WorkshopCache>();
+    bool precacheSourceGames = false;
+    bool precacheSource2Games = false;
+    bool lazyEngineDetection = false;
+    // Sorted "<library>/common/" prefixes, as listed and canonical, pointing into installDirKeys.
+    PathKeys libraryPrefixes;
+    // Per library, sorted "<installDir>/" keys of the appids installed there.
+    std::vector<PathKeys> installDirKeys;
+    // The library of installDirKeys[i].
+    std::vector<std::string_view> pathLibraries;
+    // Lower-cased names, sorted.
+    SappSortedChunks<NameKey, NameLess> nameOrder;
+    // Every word of a name but the first, sorted by the rest of the name from there on.
+    SappSortedChunks<NameKey, NameLess> wordStarts;
+    // Every trigram of every lower-cased name, sorted.
+    TrigramIndex trigrams;
+    // What the arena held when this snapshot was published; it keeps growing with later ones
+    // until a publish compacts it.
+    std::size_t arenaBytes = 0;
+};
+
+// A snapshot published to a file in shared memory (/dev/shm) for other processes on the same host,
+// so they don't each have to scan the libraries and probe the engines again. The file is
+// position-independent and used in place: attaching maps it and checks the header, queries read
+// the records straight from the mapping without allocating. Publishing writes the next generation
+// next to the file and renames it over the old one, so a reader keeps the generation it attached
+// to until it attaches again.
+//
+// Layout (native endianness, everything 8-byte aligned):
+//   Header, Root[rootCount], Game[gameCount], Slot[slotCount], char strings[stringBytes]
+// Slot is an open-addressing appid table (slotCount is a power of two) indexing Game.
+class SappSharedSnapshot
+{
+public:
+    using GameView = ISteamSearchProvider::GameView;
+
+    SappSharedSnapshot() = default;
+
+    explicit SappSharedSnapshot( const std::string &path )
+    {
+        Attach( path );
+    }
+
+    // The section pointers point into the file's buffer.
+    SappSharedSnapshot( const SappSharedSnapshot & ) = delete;
+    SappSharedSnapshot &operator=( const SappSharedSnapshot & ) = delete;
+
+    // /dev/shm/sapp-<uid>.snapshot, or a file in the temp directory where there is no /dev/shm.
+    [[nodiscard]] static std::string DefaultPath()
+    {
+#ifdef _WIN32
+        return ( fs::temp_directory_path() / "sapp.snapshot" ).string();
+#else
+        const auto name = "sapp-" + std::to_string( getuid() ) + ".snapshot";
+        std::error_code ec;
+        if ( fs::is_directory( "/dev/shm", ec ) )
+            return "/dev/shm/" + name;
+        return ( fs::temp_directory_path() / name ).string();
+#endif
+    }
+
+    // Writes snapshot as the generation after the one currently at path. Engines that aren't
+    // precached are probed for every game here, so readers never have to.
+    static bool Publish( const std::string &path, const SappSnapshot &snapshot )
+    {
+        std::string strings;
+        auto addString = [&strings]( std::string_view text, uint32 &offset, uint32 &length )
+        {
+            offset = static_cast<uint32>( strings.size() );
+            length = static_cast<uint32>( text.size() );
+            strings.append( text );
+        };
+
+        std::vector<Root> roots;
+        for ( const auto root : snapshot.GetSteamRoots() )
+        {
+            Root record{};
+            addString( root, record.path, record.pathLength );
+            roots.push_back( record );
+        }
+
+        const auto games = snapshot.GetGames();
+        std::vector<GameRecord> gameRecords;
+        gameRecords.reserve( games.size() );
+        for ( const auto &game : games )
+        {
+            GameRecord record{};
+            addString( game.GetName(), record.name, record.nameLength );
+            addString( game.GetLibrary(), record.library, record.libraryLength );
+            addString( game.GetInstallPath(), record.installPath, record.installPathLength );
+            record.installDirLength = static_cast<uint32>( game.GetInstallDir().size() );
+            addString( game.libraryCache, record.libraryCache, record.libraryCacheLength );
+            record.appid = game.appid;
+            record.root = game.GetRoot();
+            record.flags = ( snapshot.BIsSourceGame( game.appid ) ? Source : 0u ) | ( snapshot.BIsSource2Game( game.appid ) ? Source2 : 0u );
+            gameRecords.push_back( record );
+        }
+
+        std::size_t slotCount = 16;
+        while ( slotCount < games.size() * 2 )
+            slotCount <<= 1;
+        std::vector<Slot> slots( slotCount, Slot{ k_uAppIdInvalid, 0 } );
+        for ( uint32 i = 0; i < gameRecords.size(); i++ )
+        {
+            // The first game with an appid wins, like the provider's index.
+            for ( auto slot = Hash( gameRecords[i].appid, slotCount );; slot = ( slot + 1 ) & ( slotCount - 1 ) )
+            {
+                if ( slots[slot].appid == gameRecords[i].appid )
+                    break;
+                if ( slots[slot].appid == k_uAppIdInvalid )
+                {
+                    slots[slot] = { gameRecords[i].appid, i };
+                    break;
+                }
+            }
+        }
+
+        Header header{};
+        std::memcpy( header.magic, magic, sizeof( magic ) );
+        header.version = version;
+        header.generation = 1;
+        {
+            const SappMappedFile previous( path );
+            Header previousHeader{};
+            if ( previous.View().size() >= sizeof( previousHeader ) )
+            {
+                std::memcpy( &previousHeader, previous.View().data(), sizeof( previousHeader ) );
+                if ( std::memcmp( previousHeader.magic, magic, sizeof( magic ) ) == 0 )
+                    header.generation = previousHeader.generation + 1;
+            }
+        }
+        header.rootCount = static_cast<uint32>( roots.size() );
+        header.gameCount = static_cast<uint32>( gameRecords.size() );
+        header.slotCount = static_cast<uint32>( slots.size() );
+        strings.resize( ( strings.size() + 7 ) & ~std::size_t( 7 ) );
+        header.stringBytes = static_cast<uint32>( strings.size() );
+
+        std::string image;
+        image.reserve( sizeof( header ) + roots.size() * sizeof( Root ) + gameRecords.size() * sizeof( GameRecord ) + slots.size() * sizeof( Slot ) + strings.size() );
+        image.append( reinterpret_cast<const char *>( &header ), sizeof( header ) );
+        image.append( reinterpret_cast<const char *>( roots.data() ), roots.size() * sizeof( Root ) );
+        image.append( reinterpret_cast<const char *>( gameRecords.data() ), gameRecords.size() * sizeof( GameRecord ) );
+        image.append( reinterpret_cast<const char *>( slots.data() ), slots.size() * sizeof( Slot ) );
+        image.append( strings );
+
+        return SappAtomicFile::Replace( path, image );
+    }
+
+    // Maps the generation currently at path. Returns false (and holds nothing) if there is none
+    // or it isn't a valid snapshot.
+    bool Attach( const std::string &path )
+    {
+        Detach();
+        // The file is checked before and after opening, so identity always belongs to what got mapped
+        // and what got mapped is the file that passed IsTrusted().
+        for ( int attempt = 0; attempt < 8; attempt++ )
+        {
+            SappFileId before;
+            if ( !IsTrusted( path, before ) || !file.Open( path ) )
+                return false;
+            SappFileId after;
+            SappFileStamp::Of( path, &after );
+            if ( before == after )
+            {
+                identity = before;
+                break;
+            }
+            file.Close();
+        }
+        if ( !file.IsOpen() )
+            return false;
+
+        const auto data = file.View();
+        if ( data.size() < sizeof( header ) )
+            return Detach();
+        std::memcpy( &header, data.data(), sizeof( header ) );
+        if ( std::memcmp( header.magic, magic, sizeof( magic ) ) != 0 || header.version != version || !std::has_single_bit( header.slotCount ) )
+            return Detach();
+
+        const auto rootBytes = std::uint64_t( header.rootCount ) * sizeof( Root );
+        const auto gameBytes = std::uint64_t( header.gameCount ) * sizeof( GameRecord );
+        const auto slotBytes = std::uint64_t( header.slotCount ) * sizeof( Slot );
+        if ( sizeof( Header ) + rootBytes + gameBytes + slotBytes + header.stringBytes != data.size() )
+            return Detach();
+
+        roots = data.data() + sizeof( Header );
+        games = roots + rootBytes;
+        slots = games + gameBytes;
+        strings = std::string_view( slots + slotBytes, header.stringBytes );
+        attachedPath = path;
+        return true;
+    }
+
+    // Whether a newer generation has been published since Attach(); costs a stat.
+    [[nodiscard]] bool IsStale() const
+    {
+        SappFileId current;
+        SappFileStamp::Of( attachedPath, &current );
+        return !file.IsOpen() || current != identity;
+    }
+
+    [[nodiscard]] std::uint64_t Generation() const
+    {
+        return file.IsOpen() ? header.generation : 0;
+    }
+
+    [[nodiscard]] bool Available() const
+    {
+        return file.IsOpen() && header.gameCount != 0;
+    }
+
+    [[nodiscard]] uint32 GetNumInstalledApps() const
+    {
+        return file.IsOpen() ? header.gameCount : 0;
+    }
+
+    uint32 GetInstalledApps( AppId_t *pvecAppID, uint32 unMaxAppIDs ) const
+    {
+        const auto count = std::min( unMaxAppIDs, GetNumInstalledApps() );
+        for ( uint32 i = 0; i < count; i++ )
+            pvecAppID[i] = Record( i ).appid;
+        return count;
+    }
+
+    [[nodiscard]] bool BIsAppInstalled( AppId_t appID ) const
+    {
+        return FindRecord( appID ) != npos;
+    }
+
+    [[nodiscard]] bool BIsSourceGame( AppId_t appID ) const
+    {
+        const auto index = FindRecord( appID );
+        return index != npos && ( Record( index ).flags & Source );
+    }
+
+    [[nodiscard]] bool BIsSource2Game( AppId_t appID ) const
+    {
+        const auto index = FindRecord( appID );
+        return index != npos && ( Record( index ).flags & Source2 );
+    }
+
+    bool GetAppInstallDir( AppId_t appID, std::string &directory ) const
+    {
+        const auto game = Find( appID );
+        if ( !game )
+            return false;
+        directory.append( game->GetInstallPath() );
+        return true;
+    }
+
+    // A GameView whose strings point into the mapping; valid until the next Attach() or destruction.
+    [[nodiscard]] std::optional<GameView> Find( AppId_t appID ) const
+    {
+        const auto index = FindRecord( appID );
+        if ( index == npos )
+            return std::nullopt;
+        return GameAt( index );
+    }
+
+    // In game list order of the snapshot that was published. Past the end, one with an invalid appid.
+    [[nodiscard]] GameView GameAt( uint32 index ) const
+    {
+        if ( index >= GetNumInstalledApps() )
+            return GameView( {}, {}, {}, {}, k_uAppIdInvalid );
+        const auto record = Record( index );
+        const auto installPath = String( record.installPath, record.installPathLength );
+        const auto installDir = installPath.substr( installPath.size() - std::min<std::size_t>( record.installDirLength, installPath.size() ) );
+        return GameView( String( record.name, record.nameLength ), String( record.library, record.libraryLength ), installDir,
+                     String( record.libraryCache, record.libraryCacheLength ), record.appid, installPath, record.root );
+    }
+
+    [[nodiscard]] std::string_view GetSteamRoot( uint32 index ) const
+    {
+        if ( !file.IsOpen() || index >= header.rootCount )
+            return {};
+        Root record{};
+        std::memcpy( &record, roots + std::size_t( index ) * sizeof( Root ), sizeof( Root ) );
+        return String( record.path, record.pathLength );
+    }
+
+    [[nodiscard]] uint32 GetNumSteamRoots() const
+    {
+        return file.IsOpen() ? header.rootCount : 0;
+    }
+
+private:
+    static constexpr char magic[4] = { 'S', 'A', 'P', 'S' };
+    static constexpr uint32 version = 1;
+    static constexpr uint32 npos = 0xFFFFFFFFu;
+
+    enum Flags : uint32
+    {
+        Source = 1 << 0,
+        Source2 = 1 << 1,
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32 version;
+        std::uint64_t generation;
+        uint32 rootCount;
+        uint32 gameCount;
+        uint32 slotCount;
+        uint32 stringBytes;
+    };
+
+    struct Root
+    {
+        uint32 path;
+        uint32 pathLength;
+    };
+
+    struct GameRecord
+    {
+        uint32 name;
+        uint32 nameLength;
+        uint32 library;
+        uint32 libraryLength;
+        uint32 installPath;
+        uint32 installPathLength;
+        uint32 installDirLength;
+        uint32 libraryCache;
+        uint32 libraryCacheLength;
+        AppId_t appid;
+        uint32 root;
+        uint32 flags;
+    };
+
+    struct Slot
+    {
+        AppId_t appid;
+        uint32 game;
+    };
+
+    [[nodiscard]] static std::size_t Hash( AppId_t appid, std::size_t slotCount )
+    {
+        return static_cast<std::size_t>( ( appid * 0x9E3779B1u ) >> ( 32 - std::countr_zero( slotCount ) ) ) & ( slotCount - 1 );
+    }
+
+    // The default path is predictable, so only a regular file of our own that nobody else can
+    // write is attached to.
+    static bool IsTrusted( const std::string &path, SappFileId &identity )
+    {
+#ifdef _WIN32
+        return SappFileStamp::Of( path, &identity ).Exists();
+#else
+        const int fd = ::open( path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+        if ( fd < 0 )
+            return false;
+        struct stat st{};
+        const bool trusted = fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_uid == geteuid() && !( st.st_mode & ( S_IWGRP | S_IWOTH ) );
+        ::close( fd );
+        identity = { static_cast<std::uint64_t>( st.st_dev ), static_cast<std::uint64_t>( st.st_ino ) };
+        return trusted;
+#endif
+    }
+
+    [[nodiscard]] uint32 FindRecord( AppId_t appid ) const
+    {
+        if ( !file.IsOpen() || appid == k_uAppIdInvalid )
+            return npos;
+        const std::size_t mask = header.slotCount - 1;
+        for ( auto slot = Hash( appid, header.slotCount ), probes = std::size_t( 0 ); probes <= mask; slot = ( slot + 1 ) & mask, probes++ )
+        {
+            Slot entry{};
+            std::memcpy( &entry, slots + slot * sizeof( Slot ), sizeof( Slot ) );
+            if ( entry.appid == k_uAppIdInvalid )
+                return npos;
+            if ( entry.appid == appid )
+                return entry.game < header.gameCount ? entry.game : npos;
+        }
+        return npos;
+    }
+
+    [[nodiscard]] GameRecord Record( uint32 index ) const
+    {
+        GameRecord record{};
+        std::memcpy( &record, games + std::size_t( index ) * sizeof( GameRecord ), sizeof( GameRecord ) );
+        return record;
+    }
+
+    // Out of range strings come back empty instead of reading past the mapping.
+    [[nodiscard]] std::string_view String( uint32 offset, uint32 length ) const
+    {
+        if ( std::uint64_t( offset ) + length > strings.size() )
+            return {};
+        return strings.substr( offset, length );
+    }
+
+    bool Detach()
+    {
+        file.Close();
+        header = {};
+        identity = {};
+        return false;
+    }
+
+    SappMappedFile file;
+    Header header{};
+    const char *roots = nullptr;
+    const char *games = nullptr;
+    const char *slots = nullptr;
+    std::string_view strings;
+    std::string attachedPath;
+    SappFileId identity;
+};
+
+class SteamAppPathProvider final : public ISteamSearchProvider
+{
+    struct ManifestJob
+    {
+        std::string path;
+        std::size_t library;
+        std::string file;
+        // Result of an earlier scan, only used if the manifest's stamp still matches.
+        const SappScanCache::CachedManifest *cached;
+    };
+
+    struct ScannedManifest
+    {
+        std::string name;
+        std::string installDir;
+        AppId_t appid;
+        std::size_t library;
+        SappFileStamp stamp;
+        uint32 engineFlags;
+        bool isSource;
+        bool isSource2;
+        // Differs from what the scan cache holds.
+        bool updated;
+    };
+
+    // Calls visit( file ) for every manifest in directory order; stops early once visit returns false.
+    template<typename Visit>
+    static void ForEachManifest( const std::string &steamapps, [[maybe_unused]] SappScanCounters *counters, Visit &&visit )
+    {
+        std::error_code ec;
+        for ( auto const &dir_entry : fs::directory_iterator( steamapps, fs::directory_options::skip_permission_denied, ec ) )
+        {
+            SAPP_SCAN_STAT( if ( counters ) counters->directoryEntries++; )
+            auto file = dir_entry.path().filename().string();
+            if ( file.starts_with( "appmanifest_" ) && file.ends_with( ".acf" ) && !visit( std::move( file ) ) )
+                return;
+        }
+    }
+
+    static std::vector<std::string> ListManifests( const std::string &steamapps, SappScanCounters *counters = nullptr )
+    {
+        std::vector<std::string> files;
+        ForEachManifest( steamapps, counters, [&]( std::string file )
+        {
+            files.push_back( std::move( file ) );
+            return true;
+        } );
+        std::sort( files.begin(), files.end() );
+        return files;
+    }
+
+    struct ScanInstrumentation
+    {
+        SappScanStats::Phases *phases = nullptr;
+        const SappTraceCallback *trace = nullptr;
+
+        [[nodiscard]] SappScanCounters *operator[]( SappScanPhase phase ) const
+        {
+            return phases ? &( *phases )[static_cast<std::size_t>( phase )] : nullptr;
+        }
+    };
+
+    static std::optional<ScannedManifest> ScanManifest( const ManifestJob &job, const std::vector<std::string> &libraries, const SappScanOptions &options, const ScanInstrumentation &instrumentation )
+    {
+        ScannedManifest scanned{ {}, {}, 0, job.library, {}, 0, false, false, false };
+        {
+            const auto counters = instrumentation[SappScanPhase::ManifestRead];
+            std::optional<SappScanTimer> readTimer;
+            readTimer.emplace( counters, SappScanPhase::ManifestRead, instrumentation.trace, job.path );
+            SAPP_SCAN_STAT( if ( counters ) counters->statCalls++; )
+            scanned.stamp = SappFileStamp::Of( job.path );
+            if ( job.cached && job.cached->stamp == scanned.stamp )
+            {
+                scanned.appid = job.cached->appid;
+                scanned.name = job.cached->name;
+                scanned.installDir = job.cached->installDir;
+                scanned.engineFlags = job.cached->engineFlags;
+            }
+            else
+            {
+                const auto manifest = SappFileHelper( job.path );
+                SAPP_SCAN_STAT( if ( counters && manifest.IsOpen() ) { counters->filesOpened++; counters->bytesRead += manifest.View().size(); } )
+                readTimer.reset();
+
+                SappScanTimer parseTimer( instrumentation[SappScanPhase::ManifestParse], SappScanPhase::ManifestParse, instrumentation.trace, job.path );
+                if ( !ParseAppManifest( manifest.View(), scanned.appid, scanned.name, scanned.installDir ) )
+                    return std::nullopt;
+                scanned.updated = true;
+            }
+        }
+
+        const bool probeSource = options.precacheSourceGames && !( scanned.engineFlags & SappScanCache::SourceProbed );
+        const bool probeSource2 = options.precacheSource2Games && !( scanned.engineFlags & SappScanCache::Source2Probed );
+        if ( probeSource || probeSource2 )
+        {
+            std::string fullPath = libraries[job.library];
+            fullPath.append( CORRECT_PATH_SEPARATOR_S "common" CORRECT_PATH_SEPARATOR_S );
+            fullPath.append( scanned.installDir );
+
+            bool isSource = false;
+            bool isSource2 = false;
+            {
+                const auto counters = instrumentation[SappScanPhase::EngineProbe];
+                SappScanTimer timer( counters, SappScanPhase::EngineProbe, instrumentation.trace, fullPath );
+                SappProbeCounters probeCounters;
+                ProbeEngines( fullPath, probeSource, probeSource2, isSource, isSource2, counters ? &probeCounters : nullptr );
+                SAPP_SCAN_STAT( if ( counters ) counters->Add( probeCounters ); )
+            }
+            if ( probeSource )
+                scanned.engineFlags |= SappScanCache::SourceProbed | ( isSource ? uint32( SappScanCache::Source ) : 0u );
+            if ( probeSource2 )
+                scanned.engineFlags |= SappScanCache::Source2Probed | ( isSource2 ? uint32( SappScanCache::Source2 ) : 0u );
+            scanned.updated = true;
+        }
+
+        scanned.isSource = options.precacheSourceGames && ( scanned.engineFlags & SappScanCache::Source );
+        scanned.isSource2 = options.precacheSource2Games && ( scanned.engineFlags & SappScanCache::Source2 );
+        return scanned;
+    }
+
+    static void ProbeEngines( const std::string &fullPath, bool shouldPrecacheSourceGames, bool shouldPrecacheSource2Games, bool &isSource, bool &isSource2, SappProbeCounters *counters = nullptr )
+    {
+        const auto flags = SappEngineProbe::Probe( fullPath, shouldPrecacheSourceGames, shouldPrecacheSource2Games, counters );
+        isSource = flags & SappEngineProbe::Source;
+        isSource2 = flags & SappEngineProbe::Source2;
+    }
+
+    // Every Steam install folder, the primary one first; empty if none can be found. On POSIX
+    // systems SAPP_STEAM_ROOT and the usual install locations (native, XDG, Flatpak, Snap) are
+    // tried in that order and each of them with a steamapps folder is used, once even if several
+    // paths lead to it (~/.steam/steam usually links to ~/.local/share/Steam). They are a stat
+    // each, so they're looked at every time and new installs are found. Only if none has a
+    // steamapps folder are running processes looked at; that answer, found or not, is remembered
+    // for as long as HOME and SAPP_STEAM_ROOT stay the same (and a found root still exists), until
+    // Refresh().
+    static std::vector<std::string> FindSteamLocations( [[maybe_unused]] SappScanCounters *counters = nullptr )
+    {
+#ifdef _WIN32
+        char steamLocationData[SAPP_MAX_PATH];
+
+        HKEY steam;
+        if ( RegOpenKeyExA( HKEY_LOCAL_MACHINE, R"(SOFTWARE\Valve\Steam)", 0, KEY_QUERY_VALUE | KEY_WOW64_32KEY, &steam ) != ERROR_SUCCESS )
+            return {};
+
+        DWORD dwSize = sizeof(steamLocationData);
+        if ( RegQueryValueExA( steam, "InstallPath", nullptr, nullptr, (LPBYTE)steamLocationData, &dwSize ) != ERROR_SUCCESS )
+            return {};
+
+        RegCloseKey( steam );
+        return { steamLocationData };
+
+#else
+        const char *overrideRoot = getenv( "SAPP_STEAM_ROOT" );
+        const auto home = HomeDirectory();
+        std::vector<std::string> candidates;
+        if ( overrideRoot && *overrideRoot )
+            candidates.emplace_back( overrideRoot );
+        if ( !home.empty() )
+        {
+#ifdef __APPLE__
+            candidates.push_back( home + "/Library/Application Support/Steam" );
+#else
+            candidates.push_back( home + "/.steam/steam" );
+            const char *dataHome = getenv( "XDG_DATA_HOME" );
+            candidates.push_back( dataHome && *dataHome ? std::string( dataHome ) + "/Steam" : home + "/.local/share/Steam" );
+            candidates.push_back( home + "/.var/app/com.valvesoftware.Steam/.local/share/Steam" );
+            candidates.push_back( home + "/snap/steam/common/.local/share/Steam" );
+#endif
+        }
+
+        std::vector<std::string> steamLocations;
+        std::vector<SappFileId> identities;
+        for ( auto &candidate : candidates )
+        {
+            SappFileId identity;
+            if ( !IsSteamRoot( candidate, counters, &identity ) || std::find( identities.begin(), identities.end(), identity ) != identities.end() )
+                continue;
+            identities.push_back( identity );
+            steamLocations.push_back( std::move( candidate ) );
+        }
+#ifdef __linux__
+        if ( !steamLocations.empty() )
+            return steamLocations;
+
+        auto key = home;
+        key.push_back( '\0' );
+        key.append( overrideRoot ? overrideRoot : "" );
+        auto &remembered = RememberedSteamLocation();
+        std::scoped_lock lock( remembered.lock );
+        // Keys always hold a '\0', so a forgotten (empty) key never matches and an empty root under
+        // a matching key is a remembered miss.
+        if ( remembered.key != key || ( !remembered.root.empty() && !IsSteamRoot( remembered.root, counters ) ) )
+        {
+            remembered.key = std::move( key );
+            remembered.root = FindRunningSteam( counters );
+        }
+        if ( !remembered.root.empty() )
+            steamLocations.push_back( remembered.root );
+#endif
+        return steamLocations;
+#endif
+    }
+
+    static void ForgetSteamLocations()
+    {
+#ifdef __linux__
+        auto &remembered = RememberedSteamLocation();
+        std::scoped_lock lock( remembered.lock );
+        remembered.key.clear();
+        remembered.root.clear();
+#endif
+    }
+
+#ifndef _WIN32
+    struct RememberedRoot
+    {
+        std::mutex lock;
+        std::string key;
+        std::string root;
+    };
+
+    static RememberedRoot &RememberedSteamLocation()
+    {
+        static RememberedRoot remembered;
+        return remembered;
+    }
+
+    // Services often run without HOME, the passwd entry still knows it.
+    static std::string HomeDirectory()
+    {
+        if ( const char *home = getenv( "HOME" ); home && *home )
+            return home;
+
+        passwd entry{};
+        passwd *result = nullptr;
+        char buffer[SAPP_MAX_PATH];
+        if ( getpwuid_r( getuid(), &entry, buffer, sizeof( buffer ), &result ) == 0 && result && result->pw_dir )
+            return result->pw_dir;
+        return {};
+    }
+
+    static bool IsSteamRoot( const std::string &root, [[maybe_unused]] SappScanCounters *counters, SappFileId *identity = nullptr )
+    {
+        if ( root.empty() )
+            return false;
+        SAPP_SCAN_STAT( if ( counters ) counters->statCalls++; )
+        struct stat st{};
+        if ( ::stat( ( root + CORRECT_PATH_SEPARATOR_S "steamapps" ).c_str(), &st ) != 0 || !S_ISDIR( st.st_mode ) )
+            return false;
+        if ( identity )
+            *identity = { static_cast<std::uint64_t>( st.st_dev ), static_cast<std::uint64_t>( st.st_ino ) };
+        return true;
+    }
+#endif
+
+#ifdef __linux__
+    // The working directory of a running Steam client. Only numeric /proc entries are processes,
+    // and the first match ends the search.
+    static std::string FindRunningSteam( [[maybe_unused]] SappScanCounters *counters )
+    {
+        std::error_code ec;
+        for ( fs::directory_iterator it( "/proc", fs::directory_options::skip_permission_denied, ec ), end; !ec && it != end; it.increment( ec ) )
+        {
+            SAPP_SCAN_STAT( if ( counters ) counters->directoryEntries++; )
+            const auto pid = it->path().filename().string();
+            if ( pid.empty() || !std::all_of( pid.begin(), pid.end(), []( char c ) { return c >= '0' && c <= '9'; } ) )
+                continue;
+
+            const auto cwd = "/proc/" + pid + "/cwd";
+            SAPP_SCAN_STAT( if ( counters ) counters->statCalls++; )
+            if ( access( ( cwd + "/steamclient64.dll" ).c_str(), F_OK ) != 0 )
+                continue;
+
+            std::error_code linkError;
+            const auto target = fs::read_symlink( cwd, linkError ).string();
+            if ( !linkError && IsSteamRoot( target, counters ) )
+                return target;
+        }
+        return {};
+    }
+#endif
+
+    // Supports both the current layout ("0" { "path" "..." }) and the legacy one ("1" "...").
+    static std::vector<std::string> ParseLibraryFolders( std::string_view file )
+    {
+        using TokenType = SappKeyValuesTokenizer::TokenType;
+
+        std::vector<std::string> paths;
+        SappKeyValuesTokenizer tokenizer( file );
+        if ( !tokenizer.EnterBlock( "libraryfolders" ) )
+            return paths;
+
+        while ( true )
+        {
+            const auto folder = tokenizer.Next();
+            if ( folder.type != TokenType::String )
+                break;
+
+            const auto value = tokenizer.Next();
+            if ( value.type == TokenType::String )
+            {
+                AppId_t index;
+                if ( ParseNumber( folder.text, index ) )
+                    paths.push_back( SappKeyValuesTokenizer::Unescape( value.text ) );
+                continue;
+            }
+            if ( value.type != TokenType::BlockBegin )
+                break;
+
+            while ( true )
+            {
+                const auto key = tokenizer.Next();
+                if ( key.type != TokenType::String )
+                    break;
+
+                const auto keyValue = tokenizer.Next();
+                if ( keyValue.type == TokenType::BlockBegin )
+                {
+                    if ( !tokenizer.SkipBlock() )
+                        return paths;
+                    continue;
+                }
+                if ( keyValue.type != TokenType::String )
+                    return paths;
+
+                if ( SappKeyValuesTokenizer::KeyEquals( key.text, "path" ) )
+                    paths.push_back( SappKeyValuesTokenizer::Unescape( keyValue.text ) );
+            }
+        }
+        return paths;
+    }
+
+    // One Steam install.
+    struct SteamRoot
+    {
+        std::string path;
+        // <path>/steamapps/libraryfolders.vdf
+        std::string libraryFolders;
+        // <path>/appcache/librarycache/
+        std::string libraryCache;
+    };
+
+    static std::vector<SteamRoot> MakeSteamRoots( std::vector<std::string> locations )
+    {
+        std::vector<SteamRoot> roots;
+        for ( auto &location : locations )
+        {
+            auto libraryFolders = location + CORRECT_PATH_SEPARATOR_S "steamapps" CORRECT_PATH_SEPARATOR_S "libraryfolders.vdf";
+            auto libraryCache = location + CORRECT_PATH_SEPARATOR_S "appcache" CORRECT_PATH_SEPARATOR_S "librarycache" CORRECT_PATH_SEPARATOR_S;
+            roots.push_back( { std::move( location ), std::move( libraryFolders ), std::move( libraryCache ) } );
+        }
+        return roots;
+    }
+
+    struct LibraryCandidate
+    {
+        // The library's steamapps directory.
+        std::string path;
+        uint32 root;
+    };
+
+    // Reads the libraryfolders.vdf of every root concurrently. Returns the libraries in root order,
+    // each of them once: one listed by several roots, under whatever path, belongs to the first.
+    // Libraries that don't exist are kept (once per path), skipping them is up to the caller.
+    static std::vector<LibraryCandidate> DiscoverLibraries( std::span<const SteamRoot> roots, unsigned int workerCount, [[maybe_unused]] SappScanCounters *counters = nullptr )
+    {
+        struct Listed
+        {
+            std::string path;
+            SappFileId identity;
+        };
+        std::vector<std::vector<Listed>> listed( roots.size() );
+        std::vector<SappScanCounters> rootCounters( roots.size() );
+        SappWorkStealingPool::Run( roots.size(), workerCount, [&]( std::size_t root, unsigned int )
+        {
+            const auto libraryFolders = SappFileHelper( roots[root].libraryFolders );
+            SAPP_SCAN_STAT( if ( libraryFolders.IsOpen() ) { rootCounters[root].filesOpened++; rootCounters[root].bytesRead += libraryFolders.View().size(); } )
+            for ( auto &libraryPath : ParseLibraryFolders( libraryFolders.View() ) )
+            {
+                libraryPath.append( CORRECT_PATH_SEPARATOR_S "steamapps" );
+                SappFileId identity;
+                SAPP_SCAN_STAT( rootCounters[root].statCalls++; )
+                SappFileStamp::Of( libraryPath, &identity );
+                listed[root].push_back( { std::move( libraryPath ), identity } );
+            }
+        } );
+        SAPP_SCAN_STAT( if ( counters ) { for ( const auto &rootCounter : rootCounters ) *counters += rootCounter; } )
+
+        std::vector<LibraryCandidate> candidates;
+        std::vector<SappFileId> identities;
+        for ( std::size_t root = 0; root < listed.size(); root++ )
+        {
+            for ( auto &library : listed[root] )
+            {
+                if ( library.identity.Valid() ? std::find( identities.begin(), identities.end(), library.identity ) != identities.end()
+                                              : std::any_of( candidates.begin(), candidates.end(), [&]( const LibraryCandidate &known ) { return known.path == library.path; } ) )
+                    continue;
+                if ( library.identity.Valid() )
+                    identities.push_back( library.identity );
+                candidates.push_back( { std::move( library.path ), static_cast<uint32>( root ) } );
+            }
+        }
+        return candidates;
+    }
+
+    // What ScanLibraries() found, see there.
+    template<typename Result>
+    struct LibraryScan
+    {
+        struct Listing
+        {
+            SappFileStamp stamp;
+            std::vector<std::string> manifestFiles;
+            const SappScanCache::CachedLibrary *cachedLibrary = nullptr;
+            SappScanCounters counters;
+            bool relisted = false;
+        };
+
+        // Per candidate; a library that doesn't exist has no stamp and no index in libraries.
+        std::vector<Listing> listings;
+        std::vector<std::size_t> candidateLibrary;
+        // The libraries that exist, in candidate order, with the root each belongs to.
+        std::vector<std::string> libraries;
+        std::vector<uint32> librariesRoot;
+        // Every manifest of those, in library then file name order, and what scan made of it.
+        std::vector<ManifestJob> jobs;
+        std::vector<std::optional<Result>> results;
+    };
+
+    // The manifest enumeration every full scan goes through (the provider's and SappManifestTable's).
+    // Every library is listed on its own worker, an unchanged one from cache when there is one.
+    // Then scan( job, libraries, worker ) turns each manifest into a std::optional<Result> on the
+    // pool. Workers only ever write into their own vector; results are put back into manifest order
+    // afterwards.
+    template<typename Result, typename Scan>
+    static LibraryScan<Result> ScanLibraries( std::span<const LibraryCandidate> candidates, unsigned int workerCount, const SappScanCache *cache, bool countListings, const SappTraceCallback *trace, Scan &&scan )
+    {
+        LibraryScan<Result> found;
+        found.listings.resize( candidates.size() );
+        SappWorkStealingPool::Run( candidates.size(), workerCount, [&]( std::size_t i, unsigned int )
+        {
+            const auto &pathString = candidates[i].path;
+            auto &listing = found.listings[i];
+            const auto counters = countListings ? &listing.counters : nullptr;
+            SappScanTimer timer( counters, SappScanPhase::ManifestListing, trace, pathString );
+            SAPP_SCAN_STAT( listing.counters.statCalls++; )
+            listing.stamp = SappFileStamp::Of( pathString );
+            if ( !listing.stamp.Exists() )
+                return;
+
+            // An unchanged directory still holds the same manifests, so it doesn't need to be listed again.
+            listing.cachedLibrary = cache ? cache->FindLibrary( pathString ) : nullptr;
+            if ( listing.cachedLibrary && listing.cachedLibrary->stamp == listing.stamp )
+            {
+                for ( const auto &manifest : listing.cachedLibrary->manifests )
+                    listing.manifestFiles.emplace_back( manifest.file );
+            }
+            else
+            {
+                listing.relisted = true;
+                listing.manifestFiles = ListManifests( pathString, counters );
+            }
+        } );
+
+        found.candidateLibrary.assign( candidates.size(), std::string::npos );
+        for ( std::size_t i = 0; i < candidates.size(); i++ )
+        {
+            auto &listing = found.listings[i];
+            if ( !listing.stamp.Exists() )
+                continue;
+
+            const auto &pathString = candidates[i].path;
+            found.candidateLibrary[i] = found.libraries.size();
+            for ( auto &manifestFile : listing.manifestFiles )
+            {
+                const auto cachedManifest = listing.cachedLibrary ? SappScanCache::FindManifest( *listing.cachedLibrary, manifestFile ) : nullptr;
+                found.jobs.push_back( { pathString + CORRECT_PATH_SEPARATOR_S + manifestFile, found.libraries.size(), std::move( manifestFile ), cachedManifest } );
+            }
+            found.libraries.push_back( pathString );
+            found.librariesRoot.push_back( candidates[i].root );
+        }
+
+        std::vector<std::vector<std::pair<std::size_t, Result>>> workerResults( std::min<std::size_t>( workerCount, std::max<std::size_t>( found.jobs.size(), 1 ) ) );
+        SappWorkStealingPool::Run( found.jobs.size(), workerCount, [&]( std::size_t index, unsigned int worker )
+        {
+            auto result = scan( found.jobs[index], found.libraries, worker );
+            if ( result )
+                workerResults[worker].emplace_back( index, std::move( *result ) );
+        } );
+
+        found.results.resize( found.jobs.size() );
+        for ( auto &results : workerResults )
+        {
+            for ( auto &[index, result] : results )
+                found.results[index] = std::move( result );
+        }
+        return found;
+    }
+
+    using AppManifestParser = SappManifestParser<SappManifestField::AppId, SappManifestField::Name, SappManifestField::InstallDir>;
+
+    static bool ParseAppManifest( std::string_view file, AppId_t &appid, std::string &name, std::string &installDir )
+    {
+        AppManifestParser::Record record;
+        const auto parsed = AppManifestParser::Parse( file, record );
+        const auto dir = record.Get<SappManifestField::InstallDir>();
+        if ( !( parsed & AppManifestParser::Bit<SappManifestField::AppId> ) || dir.empty() )
+            return false;
+
+        appid = record.Get<SappManifestField::AppId>();
+        name = SappKeyValuesTokenizer::Unescape( record.Get<SappManifestField::Name>() );
+        installDir = SappKeyValuesTokenizer::Unescape( dir );
+        return true;
+    }
+
+    static bool ParseNumber( std::string_view text, AppId_t &out )
+    {
+        const auto result = std::from_chars( text.data(), text.data() + text.size(), out );
+        return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+    }
+
+    friend class SappAsyncScan;
+    template<SappManifestField... Fields>
+    friend class SappManifestTable;
+
+    // An empty provider for SappAsyncScan to fill in.
+    struct Unscanned
+    {
+    };
+
+    SteamAppPathProvider( Unscanned, const SappScanOptions &options )
+        : scanOptions( options )
+    {
+    }
+
+public:
+    explicit SteamAppPathProvider(bool shouldPrecacheSourceGames = false, bool shouldPrecacheSource2Games = false)
+        : SteamAppPathProvider( SappScanOptions{ .precacheSourceGames = shouldPrecacheSourceGames, .precacheSource2Games = shouldPrecacheSource2Games } )
+    {
+    }
+
+    explicit SteamAppPathProvider( const SappScanOptions &options )
+        : scanOptions( options )
+    {
+        SappScanStats *stats = nullptr;
+        SAPP_SCAN_STAT( stats = options.stats );
+        if ( stats )
+            *stats = {};
+        const auto scanStart = std::chrono::steady_clock::now();
+        const SappTraceCallback *trace = &options.trace;
+        auto phaseCounters = [stats]( SappScanPhase phase ) -> SappScanCounters *
+        {
+            return stats ? &stats->phases[static_cast<std::size_t>( phase )] : nullptr;
+        };
+
+        std::vector<SteamRoot> roots;
+        {
+            const auto counters = phaseCounters( SappScanPhase::SteamRoot );
+            SappScanTimer timer( counters, SappScanPhase::SteamRoot, trace );
+            roots = MakeSteamRoots( FindSteamLocations( counters ) );
+        }
+        if ( roots.empty() )
+            return;
+
+        SappScanCache cache;
+        const bool cacheLoaded = !options.cacheFile.empty() && cache.Load( options.cacheFile );
+        bool cacheDirty = !cacheLoaded;
+        const auto workerCount = options.parallelScan ? SappWorkStealingPool::ResolveWorkerCount( options.workerCount ) : 1u;
+
+        // The library lists only have to be parsed again when a libraryfolders.vdf changed.
+        std::vector<SappScanCache::CachedRoot> rootStamps;
+        std::vector<LibraryCandidate> candidates;
+        {
+            const auto counters = phaseCounters( SappScanPhase::LibraryFolders );
+            SappScanTimer timer( counters, SappScanPhase::LibraryFolders, trace, roots.front().libraryFolders );
+            for ( const auto &root : roots )
+            {
+                SAPP_SCAN_STAT( if ( counters ) counters->statCalls++; )
+                rootStamps.push_back( { root.path, SappFileStamp::Of( root.libraryFolders ) } );
+            }
+
+            const auto cachedRoots = cacheLoaded ? cache.Roots() : std::span<const SappScanCache::CachedRoot>();
+            if ( std::equal( cachedRoots.begin(), cachedRoots.end(), rootStamps.begin(), rootStamps.end(), []( const auto &a, const auto &b )
+                 {
+                     return a.path == b.path && a.libraryFolders == b.libraryFolders;
+                 } ) && !cachedRoots.empty() )
+            {
+                for ( const auto &library : cache.Libraries() )
+                    candidates.push_back( { std::string( library.path ), library.root } );
+            }
+            else
+            {
+                cacheDirty = true;
+                candidates = DiscoverLibraries( roots, workerCount, counters );
+            }
+        }
+
+        // Per worker, per library.
+        std::vector<std::vector<SappScanStats::Phases>> workerPhases( stats ? workerCount : 0 );
+        auto scan = ScanLibraries<ScannedManifest>( candidates, workerCount, cacheLoaded ? &cache : nullptr, stats != nullptr, trace,
+                                                    [&]( const ManifestJob &job, const std::vector<std::string> &libraries, unsigned int worker )
+        {
+            SappScanStats::Phases *phases = nullptr;
+            if ( stats )
+            {
+                auto &perLibrary = workerPhases[worker];
+                if ( perLibrary.size() <= job.library )
+                    perLibrary.resize( job.library + 1 );
+                phases = &perLibrary[job.library];
+            }
+            return ScanManifest( job, libraries, options, { phases, trace } );
+        } );
+        const auto &listings = scan.listings;
+        const auto &candidateLibrary = scan.candidateLibrary;
+        const auto &jobs = scan.jobs;
+        const auto &ordered = scan.results;
+
+        for ( std::size_t i = 0; i < candidates.size(); i++ )
+        {
+            if ( !listings[i].stamp.Exists() )
+                continue;
+            cacheDirty |= listings[i].relisted;
+            if ( stats )
+            {
+                stats->libraries.push_back( { candidates[i].path, static_cast<uint32>( listings[i].manifestFiles.size() ), {} } );
+                stats->libraries.back().phases[static_cast<std::size_t>( SappScanPhase::ManifestListing )] = listings[i].counters;
+            }
+        }
+
+        if ( stats )
+        {
+            for ( const auto &perLibrary : workerPhases )
+            {
+                for ( std::size_t library = 0; library < perLibrary.size(); library++ )
+                {
+                    for ( std::size_t phase = 0; phase < perLibrary[library].size(); phase++ )
+                        stats->libraries[library].phases[phase] += perLibrary[library][phase];
+                }
+            }
+            for ( const auto &library : stats->libraries )
+            {
+                for ( std::size_t phase = 0; phase < library.phases.size(); phase++ )
+                    stats->phases[phase] += library.phases[phase];
+            }
+        }
+
+        cacheDirty |= AdoptScan( options, roots, std::move( scan.libraries ), std::move( scan.librariesRoot ), ordered );
+
+        if ( !options.cacheFile.empty() && cacheDirty )
+        {
+            std::vector<SappScanCache::CachedManifest> cachedManifests;
+            cachedManifests.reserve( jobs.size() );
+            std::vector<std::size_t> firstManifest( libraryPaths.size() + 1, 0 );
+            for ( std::size_t i = 0; i < ordered.size(); i++ )
+            {
+                if ( !ordered[i] )
+                    continue;
+                const auto &scanned = *ordered[i];
+                cachedManifests.push_back( { jobs[i].file, scanned.stamp, scanned.appid, scanned.name, scanned.installDir, scanned.engineFlags } );
+                firstManifest[scanned.library + 1] = cachedManifests.size();
+            }
+            for ( std::size_t i = 1; i < firstManifest.size(); i++ )
+                firstManifest[i] = std::max( firstManifest[i], firstManifest[i - 1] );
+
+            std::vector<SappScanCache::CachedLibrary> cachedLibraries;
+            for ( std::size_t i = 0; i < candidates.size(); i++ )
+            {
+                std::span<const SappScanCache::CachedManifest> manifests;
+                if ( candidateLibrary[i] != std::string::npos )
+                {
+                    const auto first = firstManifest[candidateLibrary[i]];
+                    manifests = std::span<const SappScanCache::CachedManifest>( cachedManifests ).subspan( first, firstManifest[candidateLibrary[i] + 1] - first );
+                }
+                cachedLibraries.push_back( { candidates[i].path, candidates[i].root, listings[i].stamp, manifests } );
+            }
+            SappScanCache::Write( options.cacheFile, rootStamps, cachedLibraries );
+        }
+
+        if ( stats )
+            stats->totalTime = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - scanStart );
+    }
+
+    // Starts watching the libraryfolders.vdf of every Steam root and every steamapps directory for
+    // manifest changes. Returns false if watching isn't supported on this platform or the watch
+    // couldn't be set up.
+    bool EnableWatch()
+    {
+        std::scoped_lock lock( writeLock );
+        if ( watcher )
+            return true;
+        if ( steamRoots.empty() )
+            return false;
+
+        watcher = std::make_unique<SappDirectoryWatcher>();
+        if ( !WatchRoots() )
+        {
+            watcher.reset();
+            return false;
+        }
+        SyncLibraryWatches( libraryPaths );
+        watchDescriptor.store( watcher->Descriptor(), std::memory_order_release );
+        return true;
+    }
+
+    // File descriptor that becomes readable when PollChanges() has something to do, for use with poll/epoll.
+    [[nodiscard]] int GetWatchDescriptor() const
+    {
+        return watchDescriptor.load( std::memory_order_acquire );
+    }
+
+    void SetChangeCallback( std::function<void( const SappAppChange & )> callback )
+    {
+        std::scoped_lock lock( writeLock );
+        changeCallback = std::move( callback );
+    }
+
+    // Applies pending install, update and uninstall events to the game list, the appid index and the
+    // Source caches, rereading only the manifests that changed, and publishes the result as a new
+    // snapshot. Waits up to timeoutMs for the first event (0 = don't wait, -1 = forever). Returns the
+    // number of apps that changed. Removing an app moves the last game into its place, so the order
+    // of the list isn't kept across changes.
+    std::size_t PollChanges( int timeoutMs = 0, std::vector<SappAppChange> *changes = nullptr )
+    {
+        // Waiting for events only holds pollLock, so the other writers don't queue up behind an
+        // idle poll. Once set up, the watcher lives as long as the provider.
+        std::unique_lock polling( pollLock );
+        SappDirectoryWatcher *active;
+        {
+            std::scoped_lock lock( writeLock );
+            active = watcher.get();
+        }
+        if ( !active )
+            return 0;
+
+        bool overflowed = false;
+        std::vector<std::pair<int, std::string>> events;
+        active->Drain( timeoutMs, [&]( int watch, std::string_view name )
+        {
+            if ( watch < 0 )
+                overflowed = true;
+            else if ( name == "libraryfolders.vdf" || ( name.starts_with( "appmanifest_" ) && name.ends_with( ".acf" ) ) )
+                events.emplace_back( watch, name );
+        } );
+        if ( !overflowed && events.empty() )
+            return 0;
+
+        std::unique_lock lock( writeLock );
+        bool reloadLibraries = false;
+        std::set<std::pair<std::string, std::string>> touched;
+        for ( const auto &[watch, name] : events )
+        {
+            if ( name == "libraryfolders.vdf" && std::find( libraryFoldersWatches.begin(), libraryFoldersWatches.end(), watch ) != libraryFoldersWatches.end() )
+                reloadLibraries = true;
+
+            const auto library = watchedLibraries.find( watch );
+            if ( library != watchedLibraries.end() && name.starts_with( "appmanifest_" ) )
+                touched.emplace( library->second, name );
+        }
+        if ( !reloadLibraries && !overflowed && touched.empty() )
+            return 0;
+
+        // Changes are reported once the snapshot holding them is published.
+        auto next = CopySnapshot();
+        std::vector<SappAppChange> applied;
+        auto report = [&]( SappAppChange change )
+        {
+            applied.push_back( change );
+        };
+
+        if ( reloadLibraries || overflowed )
+            ReloadLibraries( *next, touched, report );
+
+        // Lost events: compare every library against what we have.
+        if ( overflowed )
+        {
+            for ( const auto &library : libraryPaths )
+            {
+                for ( auto &file : ListManifests( library ) )
+                    touched.emplace( library, std::move( file ) );
+            }
+            std::vector<AppId_t> missing;
+            for ( std::size_t i = 0; i < next->games.size(); i++ )
+            {
+                const auto &game = next->games[i];
+                if ( !fs::exists( std::string( game.library ) + CORRECT_PATH_SEPARATOR_S "appmanifest_" + std::to_string( game.appid ) + ".acf" ) )
+                    missing.push_back( game.appid );
+            }
+            for ( const auto appid : missing )
+            {
+                RemoveGame( *next, appid );
+                report( { SappAppChange::Type::Removed, appid } );
+            }
+        }
+
+        for ( const auto &[library, file] : touched )
+            ApplyManifestChange( *next, library, file, report );
+
+        // A library without changed apps is still published, GetDownloadingApps() reads the list.
+        if ( applied.empty() && std::ranges::equal( next->libraryPaths, GetSnapshot()->libraryPaths ) )
+            return 0;
+
+        Publish( std::move( next ) );
+        {
+            std::lock_guard searchPaths( searchPathLock );
+            std::erase_if( searchPathIndices, [&applied]( const auto &entry )
+            {
+                return std::any_of( applied.begin(), applied.end(), [&entry]( const SappAppChange &change ) { return change.type == SappAppChange::Type::Updated && change.appid == std::get<0>( entry.first ); } );
+            } );
+        }
+
+        // Delivered without the locks, so the callback may call back into the provider.
+        const auto callback = changeCallback;
+        lock.unlock();
+        polling.unlock();
+        for ( const auto &change : applied )
+        {
+            if ( changes )
+                changes->push_back( change );
+            if ( callback )
+                callback( change );
+        }
+        return applied.size();
+    }
+
+    // Scans everything again and publishes the result as a new snapshot.
+    void Refresh()
+    {
+        ForgetSteamLocations();
+        auto options = scanOptions;
+        options.watch = false;
+        SteamAppPathProvider fresh( options );
+
+        std::scoped_lock lock( writeLock );
+        steamRoots = std::move( fresh.steamRoots );
+        libraryRoots = std::move( fresh.libraryRoots );
+        if ( watcher )
+        {
+            WatchRoots();
+            SyncLibraryWatches( fresh.libraryPaths );
+        }
+        libraryPaths = std::move( fresh.libraryPaths );
+        snapshot.Store( fresh.GetSnapshot() );
+        std::lock_guard searchPaths( searchPathLock );
+        searchPathIndices.clear();
+    }
+
+    // The current game list, never blocks. Everything it hands out stays valid for as long as it is
+    // held; the views (GetAppIds(), GetGames(), GetOrder(), ...) are only to be had from it, as the
+    // provider's own getters return copies. Taking one snapshot for a batch of queries also saves
+    // the reference counting of a lookup per call.
+    [[nodiscard]] std::shared_ptr<const SappSnapshot> GetSnapshot() const
+    {
+        return snapshot.Load();
+    }
+
+    [[nodiscard]] bool Available() const override
+    {
+        return GetSnapshot()->Available();
+    }
+
+    [[nodiscard]] bool BIsSourceGame( AppId_t appID ) const override
+    {
+        return GetSnapshot()->BIsSourceGame( appID );
+    }
+
+    [[nodiscard]] bool BIsSource2Game( AppId_t appID ) const override
+    {
+        return GetSnapshot()->BIsSource2Game( appID );
+    }
+
+    [[nodiscard]] bool BIsAppInstalled( AppId_t appID ) const override
+    {
+        return GetSnapshot()->BIsAppInstalled( appID );
+    }
+
+    bool GetAppInstallDir(AppId_t appID, std::string &directory, [[maybe_unused]] int pFileSize = 0) const override
+    {
+        return GetSnapshot()->GetAppInstallDir( appID, directory );
+    }
+
+    [[nodiscard]] Game GetAppInstallDirEX(AppId_t appID ) const override
+    {
+        return Game( GetSnapshot()->GetAppInstallDirEX( appID ) );
+    }
+
+    // See SappSnapshot::FindAppsByName().
+    [[nodiscard]] std::vector<AppId_t> FindAppsByName( std::string_view query, std::size_t maxResults = 0 ) const
+    {
+        return GetSnapshot()->FindAppsByName( query, maxResults );
+    }
+
+    // See SappSnapshot::FindAppByPath().
+    [[nodiscard]] AppId_t FindAppByPath( std::string_view path ) const
+    {
+        return GetSnapshot()->FindAppByPath( path );
+    }
+
+    // See SappSnapshot::GetAppInstallDirs().
+    std::size_t GetAppInstallDirs( std::span<const AppId_t> appIds, std::span<char> buffer, std::span<uint32> offsets, std::span<bool> found ) const
+    {
+        return GetSnapshot()->GetAppInstallDirs( appIds, buffer, offsets, found );
+    }
+
+    // See SappSnapshot::GetGameInfoFiles().
+    [[nodiscard]] std::vector<std::string> GetGameInfoFiles( AppId_t appID ) const
+    {
+        return GetSnapshot()->GetGameInfoFiles( appID );
+    }
+
+    // See SappSnapshot::GetGameInfo().
+    [[nodiscard]] std::optional<SappGameInfo> GetGameInfo( AppId_t appID, std::string_view mod = {} ) const
+    {
+        return GetSnapshot()->GetGameInfo( appID, mod );
+    }
+
+    // See SappSnapshot::GetAppInstallSize().
+    [[nodiscard]] std::optional<SappInstallSize> GetAppInstallSize( AppId_t appID, const SappDiskUsageOptions &options = {} ) const
+    {
+        return GetSnapshot()->GetAppInstallSize( appID, options );
+    }
+
+    // See SappSnapshot::GetDiskUsage().
+    [[nodiscard]] SappDiskUsageReport GetDiskUsage( const SappDiskUsageOptions &options = {} ) const
+    {
+        return GetSnapshot()->GetDiskUsage( options );
+    }
+
+    // See SappSnapshot::GetWorkshopContent().
+    [[nodiscard]] std::shared_ptr<const SappWorkshopContent> GetWorkshopContent( AppId_t appID ) const
+    {
+        return GetSnapshot()->GetWorkshopContent( appID );
+    }
+
+    [[nodiscard]] std::vector<std::shared_ptr<const SappWorkshopContent>> GetWorkshopContent( std::span<const AppId_t> appIds, unsigned int workerCount = 0 ) const
+    {
+        return GetSnapshot()->GetWorkshopContent( appIds, workerCount );
+    }
+
+    // The apps Steam is downloading into any library, sorted by appid. Listed on every call; an
+    // app being installed for the first time may not be in the game list yet.
+    [[nodiscard]] std::vector<SappDownloadingApp> GetDownloadingApps() const
+    {
+        const auto current = GetSnapshot();
+        std::vector<SappDownloadingApp> downloading;
+        std::error_code ec;
+        for ( const auto library : current->GetLibraryPaths() )
+        {
+            for ( const auto &entry : fs::directory_iterator( std::string( library ) + CORRECT_PATH_SEPARATOR_S "downloading", fs::directory_options::skip_permission_denied, ec ) )
+            {
+                // Next to the app folders are state_<appid>_<depot>.patch files.
+                const auto name = entry.path().filename().string();
+                AppId_t appid = k_uAppIdInvalid;
+                const auto parsed = std::from_chars( name.data(), name.data() + name.size(), appid );
+                if ( parsed.ec == std::errc() && parsed.ptr == name.data() + name.size() && entry.is_directory( ec ) )
+                    downloading.push_back( { appid, entry.path().string() } );
+            }
+        }
+        std::sort( downloading.begin(), downloading.end(), []( const auto &a, const auto &b ) { return a.appid < b.appid; } );
+        return downloading;
+    }
+
+    // The lookup index over the pathId mounts of an app's gameinfo, built on first use. A cached
+    // index costs a stat of the gameinfo to hand out and is kept until the gameinfo changes,
+    // PollChanges() sees the app updated or uninstalled, or Refresh(). The index's own IsStale()
+    // also checks every mount. nullptr when the app has no such gameinfo.
+    [[nodiscard]] std::shared_ptr<const SappSearchPathIndex> GetSearchPathIndex( AppId_t appID, std::string_view mod = {}, std::string_view pathId = "game" ) const
+    {
+        std::shared_ptr<const SappSearchPathIndex> cached;
+        {
+            std::lock_guard lock( searchPathLock );
+            const auto found = searchPathIndices.find( std::tuple( appID, mod, pathId ) );
+            if ( found != searchPathIndices.end() )
+                cached = found->second;
+        }
+        if ( cached && SappFileStamp::Of( cached->GetGameInfo().GetFile() ) == cached->GetGameInfo().GetStamp() )
+            return cached;
+
+        auto info = GetGameInfo( appID, mod );
+        if ( !info )
+            return nullptr;
+
+        // Built outside the lock, two racing callers just build it twice.
+        auto index = std::make_shared<const SappSearchPathIndex>( std::move( *info ), pathId, SappWorkStealingPool::ResolveWorkerCount( scanOptions.workerCount ) );
+        std::lock_guard lock( searchPathLock );
+        searchPathIndices.insert_or_assign( SearchPathKey( appID, mod, pathId ), index );
+        return index;
+    }
+
+    // Bytes held for the game list: the Game records plus the string arena behind them.
+    [[nodiscard]] std::size_t GetStorageBytes() const
+    {
+        return GetSnapshot()->GetStorageBytes();
+    }
+
+    [[nodiscard]] uint32 GetNumInstalledApps() const override
+    {
+        return GetSnapshot()->GetNumInstalledApps();
+    }
+
+    uint32 GetInstalledApps( AppId_t *pvecAppID, uint32 unMaxAppIDs ) const override
+    {
+        return GetSnapshot()->GetInstalledApps( pvecAppID, unMaxAppIDs );
+    }
+
+    // Publishes a copy in appid order, readers of the current snapshot keep theirs. The copy is
+    // gathered through the cached appid order, and the orders already computed for the current
+    // snapshot are carried over, as the games didn't change. The path and name indices go by
+    // appid and are kept as they are. GetGamesBy() doesn't need any of this.
+    void sortGames(bool toGreater = true) override
+    {
+        std::scoped_lock lock( writeLock );
+        const auto current = GetSnapshot();
+        const auto order = current->GetOrder( SappSortKey::AppId );
+        auto next = CopySnapshot();
+        // Position in next of every game of current.
+        std::vector<uint32> moved( order.size() );
+        for ( uint32 i = 0; i < order.size(); i++ )
+        {
+            const auto from = toGreater ? order[i] : order[order.size() - 1 - i];
+            next->games.Mutable( i ) = current->games[from];
+            next->appids.Mutable( i ) = current->appids[from];
+            next->lowerNames.Mutable( i ) = current->lowerNames[from];
+            moved[from] = i;
+        }
+        next->RebuildIndex();
+
+        for ( const auto key : { SappSortKey::AppId, SappSortKey::Name, SappSortKey::Library, SappSortKey::Size } )
+        {
+            const auto &known = current->orders.Of( key );
+            if ( !known.ready.load( std::memory_order_acquire ) )
+                continue;
+            auto &carried = next->orders.Of( key );
+            std::call_once( carried.once, [&]
+            {
+                carried.indices.resize( known.indices.size() );
+                std::transform( known.indices.begin(), known.indices.end(), carried.indices.begin(), [&]( uint32 index ) { return moved[index]; } );
+                carried.ready.store( true, std::memory_order_release );
+            } );
+        }
+        Publish( std::move( next ) );
+    }
+
+    // The caller owns the array and has to delete[] it. GetSnapshot()->GetAppIds() needs no allocation.
+    [[nodiscard]] AppId_t *GetInstalledAppsEX() const override
+    {
+        const auto current = GetSnapshot();
+        auto appids = new AppId_t[current->GetNumInstalledApps()];
+        current->GetInstalledApps( appids, current->GetNumInstalledApps() );
+        return appids;
+    }
+
+private:
+    // Takes over the results of a scan, in game list order. Returns whether any of them differ from the scan cache.
+    bool AdoptScan( const SappScanOptions &options, std::vector<SteamRoot> roots, std::vector<std::string> libraries, std::vector<uint32> librariesRoot, std::span<const std::optional<ScannedManifest>> scanned )
+    {
+        auto next = std::make_shared<SappSnapshot>();
+        next->precacheSourceGames = options.precacheSourceGames;
+        next->precacheSource2Games = options.precacheSource2Games;
+        next->lazyEngineDetection = options.lazyEngineDetection;
 
-        Game &operator=( const Game &game )
+        auto &arena = *next->arena;
+        bool updated = false;
+        std::vector<std::string_view> libraryCacheViews;
+        for ( const auto &root : roots )
         {
-            if ( &game == this )
-                return *this;
-            gameName = (game.gameName);
-            library = game.library;
-            installDir = game.installDir;
-            icon = game.icon;
-            appid = game.appid;
-            return *this;
+            next->steamRoots.push_back( arena.Intern( root.path ) );
+            libraryCacheViews.push_back( arena.Intern( root.libraryCache ) );
         }
+        std::vector<std::string_view> libraryViews;
+        for ( const auto &library : libraries )
+            libraryViews.push_back( arena.Intern( library ) );
+        next->libraryPaths = libraryViews;
 
-        Game &operator=( Game &&game )
- noexcept         {
-            if ( &game == this )
-                return *this;
+        for ( const auto &manifest : scanned )
+        {
+            if ( !manifest )
+                continue;
 
-            gameName = std::move(game.gameName);
-            library = std::move(game.library);
-            installDir = std::move(game.installDir);
-            icon = std::move(game.icon);
-            appid = game.appid;
-            return *this;
+            const auto root = librariesRoot[manifest->library];
+            const auto game = MakeGame( arena, manifest->name, libraryViews[manifest->library], manifest->installDir, libraryCacheViews[root], manifest->appid, root );
+            next->games.PushBack( game );
+            next->appids.PushBack( game.appid );
+            next->lowerNames.PushBack( LowerName( arena, game.gameName ) );
+            updated |= manifest->updated;
         }
-
-        Game( std::string_view vGameName, std::string_view vLibrary, std::string_view vInstallDir, std::string_view vIcon, AppId_t vAppid )
+        next->RebuildIndex();
+        for ( const auto &manifest : scanned )
         {
-            gameName =  vGameName;
-            library =  vLibrary;
-            installDir =  vInstallDir;
-            icon =  vIcon;
-            appid = vAppid;
+            if ( manifest )
+                next->appIndex.SetFlags( manifest->appid, EngineFlags( *manifest ) );
         }
+        BuildPathIndex( *next );
+        next->RebuildNameIndex();
+        Publish( std::move( next ) );
 
-        std::string gameName;
-        std::string library;
-        std::string installDir;
-        std::string icon;
-        AppId_t appid;
-    };
-
-    [[nodiscard]] virtual bool Available() const = 0;
-
-    [[nodiscard]] virtual bool BIsAppInstalled( AppId_t appID ) const = 0;
-
-    [[nodiscard]] virtual uint32 GetNumInstalledApps() const = 0;
+        steamRoots = std::move( roots );
+        libraryPaths = std::move( libraries );
+        libraryRoots = std::move( librariesRoot );
+        if ( options.watch )
+            EnableWatch();
+        return updated;
+    }
 
-    [[nodiscard]] virtual bool BIsSourceGame( AppId_t appID ) const = 0;
+    // The full install path is stored once, with a trailing separator for the path index.
+    // installDir is its tail.
+    static GameView MakeGame( SappStringArena &arena, std::string_view name, std::string_view library, std::string_view installDir, std::string_view libraryCache, AppId_t appid, uint32 root )
+    {
+        std::string path;
+        path.reserve( library.size() + installDir.size() + 9 );
+        path.append( library );
+        path.append( CORRECT_PATH_SEPARATOR_S "common" CORRECT_PATH_SEPARATOR_S );
+        path.append( installDir );
+        path.push_back( CORRECT_PATH_SEPARATOR );
+        const auto installPath = arena.Store( path ).substr( 0, path.size() - 1 );
+        return GameView( arena.Store( name ), library, installPath.substr( installPath.size() - installDir.size() ), libraryCache, appid, installPath, root );
+    }
 
-    [[nodiscard]] virtual bool BIsSource2Game( AppId_t appID ) const = 0;
+    // Stores name lower-cased for the name index; names without upper-case letters are shared.
+    static std::string_view LowerName( SappStringArena &arena, std::string_view name )
+    {
+        if ( std::none_of( name.begin(), name.end(), []( char c ) { return c >= 'A' && c <= 'Z'; } ) )
+            return name;
+        std::string lowered( name );
+        for ( auto &c : lowered )
+            c = SappSnapshot::LowerAscii( c );
+        return arena.Store( lowered );
+    }
 
-    virtual uint32 GetInstalledApps(AppId_t *appids, uint32 unMaxAppIDs ) const = 0;
+    static std::uint8_t EngineFlags( const ScannedManifest &manifest )
+    {
+        return ( manifest.isSource ? SappSnapshot::PrecachedSource : 0 ) | ( manifest.isSource2 ? SappSnapshot::PrecachedSource2 : 0 );
+    }
 
-    virtual void sortGames(bool toGreater) = 0;
+    // Symlinked libraries are resolved once per library, paths handed to FindAppByPath may use either form.
+    std::string_view CanonicalLibrary( std::string_view library )
+    {
+        auto known = canonicalLibraries.find( library );
+        if ( known == canonicalLibraries.end() )
+        {
+            std::error_code ec;
+            auto canonical = fs::canonical( fs::path( library ), ec ).string();
+            known = canonicalLibraries.emplace( std::string( library ), ec ? std::string( library ) : std::move( canonical ) ).first;
+        }
+        return known->second;
+    }
 
-    [[nodiscard]] virtual AppId_t *GetInstalledAppsEX() const = 0;
+    // The installDirKeys slot of library, added if there is none yet. Libraries are few, they are
+    // looked up one by one.
+    uint32 PathSlot( SappSnapshot &next, std::string_view library )
+    {
+        const auto known = std::find( next.pathLibraries.begin(), next.pathLibraries.end(), library );
+        if ( known != next.pathLibraries.end() )
+            return static_cast<uint32>( known - next.pathLibraries.begin() );
 
-    virtual bool GetAppInstallDir(AppId_t appID, std::string &pchFolder, int pFileSize = 0) const = 0;
+        const auto slot = static_cast<uint32>( next.pathLibraries.size() );
+        next.pathLibraries.push_back( library );
+        next.installDirKeys.emplace_back();
+        const auto canonical = CanonicalLibrary( library );
+        for ( const auto path : { library, canonical } )
+        {
+            std::string prefix( path );
+            prefix.append( CORRECT_PATH_SEPARATOR_S "common" CORRECT_PATH_SEPARATOR_S );
+            next.libraryPrefixes.Insert( { next.arena->Intern( prefix ), slot } );
+            if ( canonical == library )
+                break;
+        }
+        return slot;
+    }
 
-    [[nodiscard]] virtual const Game & GetAppInstallDirEX(AppId_t appID ) const = 0;
+    // installDir is followed by the separator MakeGame stored.
+    static SappSnapshot::PathKey InstallDirKey( const GameView &game )
+    {
+        return { std::string_view( game.installDir.data(), game.installDir.size() + 1 ), game.appid };
+    }
 
-};
+    void IndexPath( SappSnapshot &next, const GameView &game )
+    {
+        next.installDirKeys[PathSlot( next, game.library )].Insert( InstallDirKey( game ) );
+    }
 
-class SteamAppPathProvider final : public ISteamSearchProvider
-{
-    bool basicIncludeCompare(std::string::const_iterator start, std::string_view comp)
+    void UnindexPath( SappSnapshot &next, const GameView &game )
     {
-        return std::includes(start, start+comp.length(), comp.cbegin(), comp.cend());
+        next.installDirKeys[PathSlot( next, game.library )].Erase( InstallDirKey( game ) );
     }
-public:
-    explicit SteamAppPathProvider(bool shouldPrecacheSourceGames = false, bool shouldPrecacheSource2Games = false)
+
+    void BuildPathIndex( SappSnapshot &next )
     {
-        precacheSourceGames = shouldPrecacheSourceGames;
-        precacheSource2Games = shouldPrecacheSource2Games;
-#ifdef _WIN32
-        char steamLocationData[SAPP_MAX_PATH];
+        using PathKey = SappSnapshot::PathKey;
 
-        HKEY steam;
-        if ( RegOpenKeyExA( HKEY_LOCAL_MACHINE, R"(SOFTWARE\Valve\Steam)", 0, KEY_QUERY_VALUE | KEY_WOW64_32KEY, &steam ) != ERROR_SUCCESS )
-            return;
+        next.libraryPrefixes = {};
+        next.installDirKeys.clear();
+        next.pathLibraries.clear();
+        std::vector<std::vector<PathKey>> keys;
+        for ( std::size_t i = 0; i < next.games.size(); i++ )
+        {
+            const auto &game = next.games[i];
+            const auto slot = PathSlot( next, game.library );
+            keys.resize( next.installDirKeys.size() );
+            keys[slot].push_back( InstallDirKey( game ) );
+        }
+        for ( std::size_t slot = 0; slot < keys.size(); slot++ )
+        {
+            std::sort( keys[slot].begin(), keys[slot].end(), SappSnapshot::PathLess() );
+            next.installDirKeys[slot].Assign( keys[slot] );
+        }
+    }
 
-        DWORD dwSize = sizeof(steamLocationData);
-        if ( RegQueryValueExA( steam, "InstallPath", nullptr, nullptr, (LPBYTE)steamLocationData, &dwSize ) != ERROR_SUCCESS )
-            return;
+    // A copy of the current snapshot to apply changes to. It shares the arena, which only the
+    // writer ever appends to, so strings of older snapshots are never touched.
+    [[nodiscard]] std::shared_ptr<SappSnapshot> CopySnapshot() const
+    {
+        return std::make_shared<SappSnapshot>( *GetSnapshot() );
+    }
 
-        RegCloseKey( steam );
-        std::string steamLocation{ steamLocationData };
+    // next's indices are expected to be up to date, the changes that led to it patch them.
+    void Publish( std::shared_ptr<SappSnapshot> next )
+    {
+        if ( next->arena->BytesAbandoned() >= SappStringArena::chunkSize && next->arena->BytesAbandoned() * 2 >= next->arena->BytesUsed() )
+            CompactArena( *next );
+        next->arenaBytes = next->arena->BytesReserved();
+        if ( !scanOptions.sharedSnapshotFile.empty() )
+            SappSharedSnapshot::Publish( scanOptions.sharedSnapshotFile, *next );
+        {
+            std::lock_guard searchPaths( searchPathLock );
+            std::erase_if( searchPathIndices, [&next]( const auto &entry ) { return !next->BIsAppInstalled( std::get<0>( entry.first ) ); } );
+        }
+        snapshot.Store( std::move( next ) );
+    }
 
-#else
-        std::string steamLocation;
-        steamLocation.reserve(SAPP_MAX_PATH);
+    template<typename Report>
+    void ReloadLibraries( SappSnapshot &next, std::set<std::pair<std::string, std::string>> &touched, Report &&report )
+    {
+        std::vector<std::string> candidates;
+        std::vector<uint32> candidateRoots;
+        const auto workerCount = scanOptions.parallelScan ? SappWorkStealingPool::ResolveWorkerCount( scanOptions.workerCount ) : 1u;
+        for ( auto &library : DiscoverLibraries( steamRoots, workerCount ) )
         {
-            std::string pHome = getenv( "HOME" );
-#ifdef __APPLE__
-            steamLocation.append(pHome + "/Library/Application Support/Steam");
-#else
-            steamLocation.append(pHome + "/.steam/steam");
-#endif
+            if ( !fs::exists( library.path ) )
+                continue;
+            candidates.push_back( std::move( library.path ) );
+            candidateRoots.push_back( library.root );
         }
 
-        std::error_code c;
-        if ( !fs::exists( fs::path( steamLocation ), c ) )
+        for ( const auto &library : libraryPaths )
         {
-            steamLocation = "";
-            fs::path d { "cwd/steamclient64.dll" };
-            for ( const auto &e : fs::directory_iterator( "/proc/" ) )
+            if ( std::find( candidates.begin(), candidates.end(), library ) != candidates.end() )
+                continue;
+
+            std::vector<AppId_t> removed;
+            for ( std::size_t i = 0; i < next.games.size(); i++ )
             {
-                if ( fs::exists( e / d, c ) )
-                {
-                    c.clear();
-                    const auto s = fs::read_symlink( e.path() / "cwd", c );
-                    if ( c )
-                        continue;
-                    steamLocation = s.string();
-                    break;
-                }
+                if ( next.games[i].library == library )
+                    removed.push_back( next.games[i].appid );
+            }
+            for ( const auto appid : removed )
+            {
+                RemoveGame( next, appid );
+                report( { SappAppChange::Type::Removed, appid } );
             }
-            if ( steamLocation.empty() )
-                return;
         }
-#endif
 
-        std::string librarycache = steamLocation + CORRECT_PATH_SEPARATOR_S "appcache" CORRECT_PATH_SEPARATOR_S "librarycache" CORRECT_PATH_SEPARATOR_S;
+        // Watched before listing, so nothing installed in between is missed.
+        SyncLibraryWatches( candidates );
+        for ( const auto &library : candidates )
+        {
+            if ( std::find( libraryPaths.begin(), libraryPaths.end(), library ) != libraryPaths.end() )
+                continue;
+            for ( auto &file : ListManifests( library ) )
+                touched.emplace( library, std::move( file ) );
+        }
+        libraryPaths = std::move( candidates );
+        next.libraryPaths.clear();
+        for ( const auto &library : libraryPaths )
+            next.libraryPaths.push_back( next.arena->Intern( library ) );
+        libraryRoots = std::move( candidateRoots );
+    }
 
-        steamLocation.append(CORRECT_PATH_SEPARATOR_S "steamapps" CORRECT_PATH_SEPARATOR_S "libraryfolders.vdf" );
+    template<typename Report>
+    void ApplyManifestChange( SappSnapshot &next, const std::string &library, const std::string &file, Report &&report )
+    {
+        AppId_t fileAppId = k_uAppIdInvalid;
+        ParseNumber( std::string_view( file ).substr( 12, file.size() - 16 ), fileAppId );
 
-        std::string file = SappFileHelper(steamLocation);
+        const auto libraryIndex = static_cast<std::size_t>( std::find( libraryPaths.begin(), libraryPaths.end(), library ) - libraryPaths.begin() );
+        std::optional<ScannedManifest> scanned;
+        if ( libraryIndex < libraryPaths.size() )
+            scanned = ScanManifest( { library + CORRECT_PATH_SEPARATOR_S + file, libraryIndex, file, nullptr }, libraryPaths, scanOptions, {} );
 
-        for(std::string::const_iterator it = file.cbegin(); it != file.cend(); it++)
+        if ( !scanned )
         {
-            if(*it != 'p')
-                continue;
-
-            if(basicIncludeCompare(it-1, R"("path")"))
+            // Gone, or moved to another library which reports it on its own.
+            const auto index = next.appIndex.Find( fileAppId );
+            if ( index != SappAppIdIndex::npos && next.games[index].library == library )
             {
-                it+=5;
-                while(*it != '"')
-                    it++;
+                RemoveGame( next, fileAppId );
+                report( { SappAppChange::Type::Removed, fileAppId } );
+            }
+            return;
+        }
 
-                auto currIt = it+1;
-                it++;
-                while(*it != '"')
-                    it++;
-                std::string pathString = std::string(currIt, it);
-                pathString.append(CORRECT_PATH_SEPARATOR_S "steamapps");
+        const auto index = next.appIndex.Find( scanned->appid );
+        const auto engines = EngineFlags( *scanned );
 
-                if ( !fs::exists( ( pathString ) ) )
-                    continue;
+        // Most events rewrite a manifest without changing what we keep, those never reach the arena.
+        if ( index != SappAppIdIndex::npos )
+        {
+            const auto &existing = next.games[index];
+            if ( next.appIndex.Flags( scanned->appid ) == engines && existing.gameName == scanned->name && existing.library == library && existing.installDir == scanned->installDir )
+                return;
+        }
 
-                for ( auto const &dir_entry : fs::directory_iterator( ( pathString ), fs::directory_options::skip_permission_denied ) )
-                {
-                    auto strPath = dir_entry.path().string();
+        // Replaced strings stay in the arena until a publish compacts it.
+        auto &arena = *next.arena;
+        const auto root = libraryRoots[libraryIndex];
+        const auto game = MakeGame( arena, scanned->name, arena.Intern( library ), scanned->installDir, arena.Intern( steamRoots[root].libraryCache ), scanned->appid, root );
+        if ( index == SappAppIdIndex::npos )
+        {
+            AddGame( next, game, engines );
+            report( { SappAppChange::Type::Installed, scanned->appid } );
+            return;
+        }
 
-                    if ( !fs::exists( ( strPath ) ) )
-                        continue;
+        UnindexPath( next, next.games[index] );
+        next.UnindexName( index );
+        AbandonStrings( next, index );
+        next.games.Mutable( index ) = game;
+        next.lowerNames.Mutable( index ) = LowerName( arena, game.gameName );
+        next.appIndex.ResetEngineState( game.appid );
+        next.appIndex.SetFlags( game.appid, engines );
+        IndexPath( next, game );
+        next.IndexName( index );
+        report( { SappAppChange::Type::Updated, scanned->appid } );
+    }
 
-                    auto indd = strPath.find( "appmanifest_" );
-                    auto indd2 = strPath.rfind( ".acf" );
-                    if ( ( indd <= strPath.length() ) && ( indd2 <= strPath.length() ) )
-                    {
+    // Appends game to the list and its indices.
+    void AddGame( SappSnapshot &next, const GameView &game, std::uint8_t engines )
+    {
+        const auto index = static_cast<uint32>( next.games.size() );
+        next.games.PushBack( game );
+        next.appids.PushBack( game.appid );
+        next.lowerNames.PushBack( LowerName( *next.arena, game.gameName ) );
+        next.appIndex.Insert( game.appid, index );
+        next.appIndex.SetFlags( game.appid, engines );
+        IndexPath( next, game );
+        next.IndexName( index );
+    }
 
-                        auto pathFile = SappFileHelper(std::string(strPath));
+    // The strings MakeGame and LowerName stored for a game; the interned ones stay in use.
+    static void AbandonStrings( SappSnapshot &next, uint32 index )
+    {
+        const auto &game = next.games[index];
+        const auto lowerName = next.lowerNames[index];
+        next.arena->Abandon( game.gameName.size() + game.installPath.size() + 1 + ( lowerName.data() != game.gameName.data() ? lowerName.size() : 0 ) );
+    }
 
-                        std::string keyName;
-                        std::string keyInstallDir;
-                        std::string appid;
+    // Moves the strings next uses into a fresh arena and rebuilds the indices pointing into it. The
+    // snapshots published before keep the old one, and with it the strings replaced since. It only
+    // runs once half of the arena was replaced, so spread over those changes it costs them little.
+    void CompactArena( SappSnapshot &next )
+    {
+        auto arena = std::make_shared<SappStringArena>();
+        for ( auto &root : next.steamRoots )
+            root = arena->Intern( root );
+        for ( auto &library : next.libraryPaths )
+            library = arena->Intern( library );
+        for ( std::size_t i = 0; i < next.games.size(); i++ )
+        {
+            const auto &game = next.games[i];
+            const auto moved = MakeGame( *arena, game.gameName, arena->Intern( game.library ), game.installDir, arena->Intern( game.libraryCache ), game.appid, game.root );
+            next.games.Mutable( i ) = moved;
+            next.lowerNames.Mutable( i ) = LowerName( *arena, moved.gameName );
+        }
+        next.arena = std::move( arena );
+        BuildPathIndex( next );
+        next.RebuildNameIndex();
+    }
 
-                        for(std::string::const_iterator itr = pathFile.cbegin(); itr != pathFile.cend(); itr++)
-                        {
-                            if(*itr != 'a' && *itr != 'i' && *itr != 'n')
-                                continue;
-                            if(basicIncludeCompare(itr-1, R"("appid")"))
-                            {
-                                itr += 6;
-                                while (*itr != '"')
-                                    itr++;
-
-                                auto currItr = itr + 1;
-                                itr++;
-                                while (*itr != '"')
-                                    itr++;
-                                appid = std::string{currItr, itr};
-                            };
-                            if(basicIncludeCompare(itr-1, R"("installdir")"))
-                            {
-                                itr += 11;
-                                while (*itr != '"')
-                                    itr++;
-
-                                auto currItr = itr + 1;
-                                itr++;
-                                while (*itr != '"')
-                                    itr++;
-                                keyInstallDir = {currItr, itr};
-                            };
-                            if(basicIncludeCompare(itr-1, R"("name")"))
-                            {
-                                itr += 5;
-                                while (*itr != '"')
-                                    itr++;
-
-                                auto currItr = itr + 1;
-                                itr++;
-                                while (*itr != '"')
-                                    itr++;
-                                keyName = {currItr, itr};
-                            };
+    // The steamapps directory of every root, for changes to its libraryfolders.vdf.
+    bool WatchRoots()
+    {
+        libraryFoldersWatches.clear();
+        for ( const auto &root : steamRoots )
+        {
+            const auto watch = watcher->Add( fs::path( root.libraryFolders ).parent_path().string() );
+            if ( watch < 0 )
+                return false;
+            libraryFoldersWatches.push_back( watch );
+        }
+        return true;
+    }
 
-                        }
+    // Watches the libraries that aren't watched yet and drops the watches of those that are gone.
+    void SyncLibraryWatches( const std::vector<std::string> &libraries )
+    {
+        for ( const auto &library : libraries )
+        {
+            const auto watched = std::find_if( watchedLibraries.begin(), watchedLibraries.end(), [&]( const auto &entry ) { return entry.second == library; } );
+            if ( watched != watchedLibraries.end() )
+                continue;
+            const auto watch = watcher->Add( library );
+            if ( watch >= 0 )
+                watchedLibraries[watch] = library;
+        }
 
-                        std::string icon( librarycache + appid + "_icon.jpg" );
+        std::erase_if( watchedLibraries, [&]( const auto &watched )
+        {
+            const bool stale = std::find( libraries.begin(), libraries.end(), watched.second ) == libraries.end();
+            // A root's steamapps directory shares its watch with the library it holds.
+            if ( stale && std::find( libraryFoldersWatches.begin(), libraryFoldersWatches.end(), watched.first ) == libraryFoldersWatches.end() )
+                watcher->Remove( watched.first );
+            return stale;
+        } );
+    }
 
-                        std::string fullPath = ( pathString );
-                        fullPath.append((CORRECT_PATH_SEPARATOR_S "common" CORRECT_PATH_SEPARATOR_S));
-                        fullPath.append(keyInstallDir);
+    // Moves the last game into its place; the path and name indices go by appid, so they only lose
+    // the removed one.
+    void RemoveGame( SappSnapshot &next, AppId_t appid )
+    {
+        const auto index = next.appIndex.Find( appid );
+        if ( index == SappAppIdIndex::npos )
+            return;
 
-                        if ( (shouldPrecacheSource2Games || shouldPrecacheSourceGames) && std::filesystem::exists( fullPath ) ) {
-                            auto dirIterator = std::filesystem::directory_iterator{fullPath,
-                                                                                   std::filesystem::directory_options::skip_permission_denied};
+        UnindexPath( next, next.games[index] );
+        next.UnindexName( index );
+        AbandonStrings( next, index );
+        next.appIndex.Erase( appid );
+        {
+            std::scoped_lock lock( next.workshop->lock );
+            next.workshop->contents.erase( appid );
+        }
+        const auto last = next.games.size() - 1;
+        if ( index != last )
+        {
+            next.games.Mutable( index ) = next.games[last];
+            next.appids.Mutable( index ) = next.appids[last];
+            next.lowerNames.Mutable( index ) = next.lowerNames[last];
+            next.appIndex.Assign( next.games[index].appid, index );
+        }
+        next.games.PopBack();
+        next.appids.PopBack();
+        next.lowerNames.PopBack();
+    }
 
-                            for(const auto& dir_entry2 : dirIterator)
-                            {
-                                if (!dir_entry2.is_directory()) {
-                                    continue;
-                                }
+    SappRcuCell<SappSnapshot> snapshot{ std::make_shared<const SappSnapshot>() };
 
-                                if(shouldPrecacheSourceGames && std::filesystem::exists(dir_entry2.path() / "gameinfo.txt"))
-                                {
-                                    sourceGames.insert(stoi(appid));
-                                    break;
-                                }
+    // Serializes the writers (PollChanges, Refresh, sortGames, ...), readers never take it.
+    std::mutex writeLock;
+    // Serializes PollChanges() callers, taken before writeLock and held while waiting for events.
+    std::mutex pollLock;
+    SappScanOptions scanOptions;
+    std::vector<SteamRoot> steamRoots;
+    std::vector<std::string> libraryPaths;
+    // Index into steamRoots per library.
+    std::vector<uint32> libraryRoots;
 
-                                if (shouldPrecacheSource2Games && std::filesystem::exists(dir_entry2.path() / "gameinfo.gi")) {
-                                    source2Games.insert(stoi(appid));
-                                    break;
-                                }
+    std::unique_ptr<SappDirectoryWatcher> watcher;
+    // watcher's descriptor, set once the watch is up so GetWatchDescriptor() needn't lock.
+    std::atomic<int> watchDescriptor{ -1 };
+    std::vector<int> libraryFoldersWatches;
+    std::map<int, std::string> watchedLibraries;
+    std::function<void( const SappAppChange & )> changeCallback;
+    std::map<std::string, std::string, std::less<>> canonicalLibraries;
 
-                                if(!shouldPrecacheSource2Games)
-                                    break;
+    // appid, mod, path ID.
+    using SearchPathKey = std::tuple<AppId_t, std::string, std::string>;
+    mutable std::mutex searchPathLock;
+    mutable std::map<SearchPathKey, std::shared_ptr<const SappSearchPathIndex>, std::less<>> searchPathIndices;
+};
 
-                                for (auto const &subdir_entry: std::filesystem::directory_iterator{dir_entry2.path(),
-                                                                                                   std::filesystem::directory_options::skip_permission_denied}) {
-                                    if (subdir_entry.is_directory() && std::filesystem::exists(subdir_entry.path() / "gameinfo.gi")) {
-                                        source2Games.insert(stoi(appid));
-                                        break;
-                                    }
-                                }
+struct SappScanEvent
+{
+    enum class Type
+    {
+        // A manifest was parsed. The engine fields aren't set yet.
+        GameDiscovered,
+        // Follows the GameDiscovered event of the same app when Source or Source 2 games are precached.
+        EngineClassified,
+        // The last event of a scan. Result() is ready by the time either is delivered.
+        Completed,
+        Cancelled,
+    };
 
-                            }
+    Type type;
+    AppId_t appid = k_uAppIdInvalid;
+    std::string name;
+    // The steamapps folder, like Game::GetLibrary().
+    std::string library;
+    std::string installDir;
+    bool isSource = false;
+    bool isSource2 = false;
+};
 
-                        }
-                        games.emplace_back(keyName, pathString, keyInstallDir, icon, static_cast<AppId_t>( stoi( appid ) ) );
-                    }
-                }
+// Scans on a background thread and reports every game as soon as its manifest is parsed, through
+// the callback when there is one and through Poll() otherwise. Libraries are scanned concurrently
+// and in directory order, so the first game neither waits for the slowest library nor for a full
+// listing. Precached engines are probed once all games of a library went out. The provider in
+// Result() holds the same games, in the same order, as one built by the constructor.
+// The cacheFile and stats options are ignored.
+class SappAsyncScan
+{
+public:
+    using Callback = std::function<void( const SappScanEvent & )>;
 
-            };
-        }
+    // The callback is called from the scan threads, one call at a time. If it throws, the scan
+    // stops and Result() holds the exception.
+    explicit SappAsyncScan( SappScanOptions scanOptions = {}, Callback eventCallback = {} )
+        : options( std::move( scanOptions ) ), callback( std::move( eventCallback ) ), result( promise.get_future().share() ),
+          thread( [this]( std::stop_token stop ) { Scan( stop ); } )
+    {
+    }
 
+    // Cancels the scan and waits for it to stop.
+    ~SappAsyncScan() = default;
 
+    SappAsyncScan( const SappAsyncScan & ) = delete;
+    SappAsyncScan &operator=( const SappAsyncScan & ) = delete;
 
+    // Stops before the next manifest or probe; Result() then holds nullptr.
+    void Cancel()
+    {
+        thread.request_stop();
+    }
 
-//        KeyValueRoot libFolder = KeyValueRoot( file.c_str() );
-//
-//        if ( !libFolder.IsValid() )
-//            return;
-//
-//        libFolder.Solidify();
-//
-//        auto &libKeyValue = libFolder["libraryfolders"];
-//        for ( int i = 0; i < libKeyValue.ChildCount(); i++ )
-//        {
-//            KeyValue &folder = libKeyValue.At( i );
-//            const char *name = folder.Key().string;
-//            if ( !strcmp( name, "TimeNextStatsReport" ) || !strcmp( name, "ContentStatsID" ) )
-//                continue;
-//
-//            auto pathValue = folder["path"].Value();
-//            if ( !pathValue.string )
-//                pathValue = folder.Value();
-//            if ( !pathValue.string )
-//                continue;
-//
-//            std::string pathString = std::string( pathValue.string );
-//            pathString.append(CORRECT_PATH_SEPARATOR_S "steamapps");
-//
-//            if ( !fs::exists( ( pathString ) ) )
-//                continue;
-//
-//            for ( auto const &dir_entry : fs::directory_iterator( ( pathString ), fs::directory_options::skip_permission_denied ) )
-//            {
-//                auto strPath = dir_entry.path().string();
-//
-//                if ( !fs::exists( ( strPath ) ) )
-//                    continue;
-//
-//                auto indd = strPath.find( "appmanifest_" );
-//                auto indd2 = strPath.rfind( ".acf" );
-//                if ( ( indd <= strPath.length() ) && ( indd2 <= strPath.length() ) )
-//                {
-//
-//                    auto pathFile = SappFileHelper(std::string(strPath));
-//                    KeyValueRoot appManifest = KeyValueRoot( pathFile.c_str() );
-//
-//                    if ( !appManifest.IsValid() )
-//                        return;
-//
-//                    KeyValue &appState = appManifest["AppState"];
-//
-//                    if ( appState["name"].Value().string == nullptr )
-//                        continue;
-//
-//                    std::string keyName = (appState["name"].Value().string);
-//                    std::string keyInstallDir = (appState["installdir"].Value().string);
-//                    std::string appid = (appState["appid"].Value().string);
-//
-//                    std::string icon( librarycache + appid + "_icon.jpg" );
-//
-//                    std::string fullPath = ( pathString );
-//                    fullPath.append((CORRECT_PATH_SEPARATOR_S "common" CORRECT_PATH_SEPARATOR_S));
-//                    fullPath.append(keyInstallDir);
-//
-//                    if ( (shouldPrecacheSource2Games || shouldPrecacheSourceGames) && std::filesystem::exists( fullPath ) ) {
-//                        auto dirIterator = std::filesystem::directory_iterator{fullPath,
-//                                                                               std::filesystem::directory_options::skip_permission_denied};
-//
-//                        for(const auto& dir_entry2 : dirIterator)
-//                        {
-//                            if (!dir_entry2.is_directory()) {
-//                                continue;
-//                            }
-//
-//                            if(shouldPrecacheSourceGames && std::filesystem::exists(dir_entry2.path() / "gameinfo.txt"))
-//                            {
-//                                sourceGames.insert(stoi(appid));
-//                                break;
-//                            }
-//
-//                            if (shouldPrecacheSource2Games && std::filesystem::exists(dir_entry2.path() / "gameinfo.gi")) {
-//                                source2Games.insert(stoi(appid));
-//                                break;
-//                            }
-//
-//                            if(!shouldPrecacheSource2Games)
-//                                break;
-//
-//                            for (auto const &subdir_entry: std::filesystem::directory_iterator{dir_entry2.path(),
-//                                                                                               std::filesystem::directory_options::skip_permission_denied}) {
-//                                if (subdir_entry.is_directory() && std::filesystem::exists(subdir_entry.path() / "gameinfo.gi")) {
-//                                    source2Games.insert(stoi(appid));
-//                                    break;
-//                                }
-//                            }
-//
-//                        }
-//
-//                    }
-//                    games.emplace_back(keyName, pathString, keyInstallDir, icon, static_cast<AppId_t>( stoi( appid ) ) );
-//                }
-//            }
-//        }
+    // Every event has been delivered.
+    [[nodiscard]] bool IsDone() const
+    {
+        std::scoped_lock lock( queueLock );
+        return done;
     }
 
-    [[nodiscard]] bool Available() const override
+    // Moves the queued events into events. Waits up to timeoutMs (-1 = forever) for one to
+    // arrive unless the scan is done. Returns the number of events added.
+    std::size_t Poll( std::vector<SappScanEvent> &events, int timeoutMs = 0 )
     {
-        return !games.empty();
+        std::unique_lock lock( queueLock );
+        const auto ready = [this] { return !queue.empty() || done; };
+        if ( timeoutMs < 0 )
+            queueReady.wait( lock, ready );
+        else
+            queueReady.wait_for( lock, std::chrono::milliseconds( timeoutMs ), ready );
+
+        const auto count = queue.size();
+        std::move( queue.begin(), queue.end(), std::back_inserter( events ) );
+        queue.clear();
+        return count;
     }
 
-    [[nodiscard]] bool BIsSourceGame( AppId_t appID ) const override
+    // The scanned provider, nullptr if the scan was cancelled.
+    [[nodiscard]] std::shared_future<std::shared_ptr<SteamAppPathProvider>> Result() const
     {
-        if(precacheSourceGames)
-            return sourceGames.contains(appID);
+        return result;
+    }
 
-        if ( !BIsAppInstalled( appID ) )
-            return false;
+    std::shared_ptr<SteamAppPathProvider> Wait() const
+    {
+        return result.get();
+    }
 
-        std::string dirPath{};
-        dirPath.reserve(SAPP_MAX_PATH);
-        GetAppInstallDir(appID, dirPath);
+private:
+    using ScannedManifest = SteamAppPathProvider::ScannedManifest;
 
-        if ( !std::filesystem::exists( dirPath ) )
+    void Scan( std::stop_token stop )
+    {
+        bool resultSet = false;
+        try
         {
-            return false;
+            auto provider = ScanLibraries( stop );
+            const auto type = provider ? SappScanEvent::Type::Completed : SappScanEvent::Type::Cancelled;
+            promise.set_value( std::move( provider ) );
+            resultSet = true;
+            Emit( { type, k_uAppIdInvalid, {}, {}, {} } );
+        }
+        catch ( ... )
+        {
+            if ( !resultSet )
+                promise.set_exception( std::current_exception() );
         }
 
-        auto dirIterator = std::filesystem::directory_iterator { std::string( dirPath ), std::filesystem::directory_options::skip_permission_denied };
-
-        return std::any_of(begin(dirIterator), end(dirIterator), [&](auto dir_entry){
-            return std::filesystem::exists( dir_entry.path() / "gameinfo.txt" );
-        });
-
+        std::scoped_lock lock( queueLock );
+        done = true;
+        queueReady.notify_all();
     }
 
-    [[nodiscard]] bool BIsSource2Game( AppId_t appID ) const override
+    std::shared_ptr<SteamAppPathProvider> ScanLibraries( const std::stop_token &stop )
     {
-        if(precacheSource2Games)
-            return source2Games.contains(appID);
-
-        if ( !BIsAppInstalled( appID ) )
-            return false;
-
-        std::string dirPath{};
-        dirPath.reserve(SAPP_MAX_PATH);
-        GetAppInstallDir(appID, dirPath);
+        std::shared_ptr<SteamAppPathProvider> provider( new SteamAppPathProvider( SteamAppPathProvider::Unscanned{}, options ) );
+        auto roots = SteamAppPathProvider::MakeSteamRoots( SteamAppPathProvider::FindSteamLocations() );
+        if ( roots.empty() )
+            return stop.stop_requested() ? nullptr : provider;
 
-        if ( !std::filesystem::exists( dirPath ) )
-            return false;
+        const auto workerCount = SappWorkStealingPool::ResolveWorkerCount( options.workerCount );
+        std::vector<std::string> libraries;
+        std::vector<uint32> librariesRoot;
+        for ( auto &library : SteamAppPathProvider::DiscoverLibraries( roots, workerCount ) )
+        {
+            if ( !SappFileStamp::Of( library.path ).Exists() )
+                continue;
+            libraries.push_back( std::move( library.path ) );
+            librariesRoot.push_back( library.root );
+        }
 
+        // Engines are probed separately, after the games went out.
+        auto discovery = options;
+        discovery.precacheSourceGames = false;
+        discovery.precacheSource2Games = false;
+        const bool probe = options.precacheSourceGames || options.precacheSource2Games;
+        const SteamAppPathProvider::ScanInstrumentation instrumentation{ nullptr, &options.trace };
 
-        for ( auto const &dir_entry : std::filesystem::directory_iterator { std::string( dirPath ), std::filesystem::directory_options::skip_permission_denied } )
+        // Per library: manifest file name and what it held, in directory order.
+        std::vector<std::vector<std::pair<std::string, std::optional<ScannedManifest>>>> found( libraries.size() );
+        SappWorkStealingPool::Run( libraries.size(), workerCount, [&]( std::size_t library, unsigned int )
         {
-            if ( !dir_entry.is_directory() )
+            const auto &libraryPath = libraries[library];
+            auto &manifests = found[library];
+            SteamAppPathProvider::ForEachManifest( libraryPath, nullptr, [&]( std::string file )
             {
-                continue;
-            }
-            if ( std::filesystem::exists( dir_entry.path() / "gameinfo.gi" ) )
+                if ( stop.stop_requested() )
+                    return false;
+                auto scanned = SteamAppPathProvider::ScanManifest( { libraryPath + CORRECT_PATH_SEPARATOR_S + file, library, file, nullptr }, libraries, discovery, instrumentation );
+                if ( scanned )
+                    Emit( { SappScanEvent::Type::GameDiscovered, scanned->appid, scanned->name, libraryPath, scanned->installDir } );
+                manifests.emplace_back( std::move( file ), std::move( scanned ) );
                 return true;
+            } );
 
-
-            for ( auto const &subdir_entry : std::filesystem::directory_iterator { dir_entry.path(), std::filesystem::directory_options::skip_permission_denied } )
+            for ( auto &[file, scanned] : manifests )
             {
-                if ( subdir_entry.is_directory() && std::filesystem::exists( subdir_entry.path() / "gameinfo.gi" ) )
-                    return true;
+                if ( !probe || stop.stop_requested() )
+                    return;
+                if ( !scanned )
+                    continue;
 
+                std::string fullPath = libraryPath;
+                fullPath.append( CORRECT_PATH_SEPARATOR_S "common" CORRECT_PATH_SEPARATOR_S );
+                fullPath.append( scanned->installDir );
+                SteamAppPathProvider::ProbeEngines( fullPath, options.precacheSourceGames, options.precacheSource2Games, scanned->isSource, scanned->isSource2 );
+                Emit( { SappScanEvent::Type::EngineClassified, scanned->appid, scanned->name, libraryPath, scanned->installDir, scanned->isSource, scanned->isSource2 } );
             }
+        } );
+        if ( stop.stop_requested() )
+            return nullptr;
+
+        std::vector<std::optional<ScannedManifest>> ordered;
+        for ( auto &manifests : found )
+        {
+            std::sort( manifests.begin(), manifests.end(), []( const auto &a, const auto &b ) { return a.first < b.first; } );
+            for ( auto &manifest : manifests )
+                ordered.push_back( std::move( manifest.second ) );
         }
-        return false;
+
+        provider->AdoptScan( options, std::move( roots ), std::move( libraries ), std::move( librariesRoot ), ordered );
+        return provider;
     }
 
-    [[nodiscard]] bool BIsAppInstalled( AppId_t appID ) const override
+    void Emit( SappScanEvent event )
     {
-        const auto game = std::find_if( games.begin(), games.end(), [appID]( const Game &g )
+        if ( callback )
         {
-            return g.appid == appID;
-        } );
-        return game != games.end();
+            std::scoped_lock lock( callbackLock );
+            callback( event );
+            return;
+        }
+
+        std::scoped_lock lock( queueLock );
+        queue.push_back( std::move( event ) );
+        queueReady.notify_all();
     }
 
-    bool GetAppInstallDir(AppId_t appID, std::string &directory, int pFileSize = 0) const override
-    {
-        const auto game = std::find_if( games.begin(), games.end(), [appID]( const Game &g )
-        {
-            return g.appid == appID;
-        } );
-        if ( games.end() == game )
-            return false;
+    const SappScanOptions options;
+    const Callback callback;
+    std::promise<std::shared_ptr<SteamAppPathProvider>> promise;
+    std::shared_future<std::shared_ptr<SteamAppPathProvider>> result;
 
-        directory.append(game->library + CORRECT_PATH_SEPARATOR_S "common" CORRECT_PATH_SEPARATOR_S + game->installDir);
+    std::mutex callbackLock;
+    mutable std::mutex queueLock;
+    std::condition_variable queueReady;
+    std::vector<SappScanEvent> queue;
+    bool done = false;
 
-        return true;
-    }
+    // Last, so it is joined before anything it uses goes away.
+    std::jthread thread;
+};
+
+// The installed apps of every library with just the requested manifest fields, for callers that
+// only need e.g. appids and sizes: no names, paths, engine detection or watching, and one record
+// per app of exactly the size of those fields. Goes through the provider's scan loop, so it finds
+// the same manifests; a field missing from a manifest is left empty, apps without a valid appid
+// are skipped when AppId is requested. Strings are unescaped and owned by the table.
+template<SappManifestField... Fields>
+class SappManifestTable
+{
+public:
+    using Parser = SappManifestParser<Fields...>;
+    using Record = typename Parser::Record;
 
-    [[nodiscard]] const Game & GetAppInstallDirEX(AppId_t appID ) const override
+    explicit SappManifestTable( const SappScanOptions &options = {} )
     {
-        const Game& game = *std::find_if( games.cbegin(), games.cend(), [appID]( const Game &g )
+        const auto roots = SteamAppPathProvider::MakeSteamRoots( SteamAppPathProvider::FindSteamLocations() );
+        const auto workerCount = options.parallelScan ? SappWorkStealingPool::ResolveWorkerCount( options.workerCount ) : 1u;
+        const auto candidates = SteamAppPathProvider::DiscoverLibraries( roots, workerCount );
+
+        // Every worker fills its own arena, the arenas are kept as they are afterwards.
+        arenas.resize( workerCount );
+        using Job = SteamAppPathProvider::ManifestJob;
+        const auto scan = SteamAppPathProvider::ScanLibraries<Record>( candidates, workerCount, nullptr, false, &options.trace,
+                                                                       [this]( const Job &job, const std::vector<std::string> &, unsigned int worker ) -> std::optional<Record>
         {
-            return g.appid == appID;
-        } );
+            const auto manifest = SteamAppPathProvider::SappFileHelper( job.path );
+            Record record;
+            const auto parsed = Parser::Parse( manifest.View(), record );
+            if ( parsed == 0 )
+                return std::nullopt;
+            if constexpr ( Record::template Has<SappManifestField::AppId> )
+            {
+                if ( !( parsed & Parser::template Bit<SappManifestField::AppId> ) )
+                    return std::nullopt;
+            }
 
-        const Game& cend =  *games.cend();
+            std::string unescaped;
+            StoreStrings( record, arenas[worker], unescaped, std::index_sequence_for<decltype( Fields )...>{} );
+            return record;
+        } );
 
-        if ( &cend == &game )
-            return *games.cend();
+        records.reserve( scan.results.size() );
+        for ( const auto &record : scan.results )
+        {
+            if ( record )
+                records.push_back( *record );
+        }
+        if constexpr ( Record::template Has<SappManifestField::AppId> )
+        {
+            appIndex.Reset( records.size() );
+            for ( std::size_t i = 0; i < records.size(); i++ )
+                appIndex.Insert( records[i].template Get<SappManifestField::AppId>(), static_cast<uint32>( i ) );
+        }
+    }
 
+    // In manifest file name order per library, libraries in libraryfolders.vdf order.
+    [[nodiscard]] std::span<const Record> Records() const
+    {
+        return records;
+    }
 
-        return game;
+    [[nodiscard]] const Record *Find( AppId_t appid ) const
+        requires Record::template Has<SappManifestField::AppId>
+    {
+        const auto index = appIndex.Find( appid );
+        return index == SappAppIdIndex::npos ? nullptr : &records[index];
     }
 
-    [[nodiscard]] uint32 GetNumInstalledApps() const override
+    // Bytes held for the records and their strings.
+    [[nodiscard]] std::size_t GetStorageBytes() const
     {
-        return games.size();
+        std::size_t bytes = records.capacity() * sizeof( Record );
+        for ( const auto &arena : arenas )
+            bytes += arena.BytesReserved();
+        return bytes;
     }
 
-    uint32 GetInstalledApps( AppId_t *pvecAppID, uint32 unMaxAppIDs ) const override
+private:
+    template<std::size_t... Index>
+    static void StoreStrings( Record &record, SappStringArena &arena, std::string &unescaped, std::index_sequence<Index...> )
     {
-        for ( int i = 0; i < unMaxAppIDs && i < games.size(); i++ )
-            pvecAppID[i] = games.at( i ).appid;
-        return unMaxAppIDs <= games.size() ? unMaxAppIDs : games.size();
+        ( StoreString( record.template Get<Record::fields[Index]>(), arena, unescaped ), ... );
     }
 
-    void sortGames(bool toGreater = true) override
+    static void StoreString( std::string_view &text, SappStringArena &arena, std::string &unescaped )
     {
-        std::sort(games.begin(), games.end(), [toGreater](const Game &game1, const Game &game2){
-            return toGreater ? game1.appid < game2.appid : game2.appid < game1.appid;
-        });
+        unescaped.clear();
+        SappKeyValuesTokenizer::AppendUnescaped( unescaped, text );
+        text = arena.Store( unescaped );
     }
 
-    [[nodiscard]] AppId_t *GetInstalledAppsEX() const override
+    template<typename Number>
+    static void StoreString( Number &, SappStringArena &, std::string & )
     {
-        auto appids = new AppId_t[GetNumInstalledApps()];
-        for ( int i = 0; i < games.size(); i++ )
-            appids[i] = games.at(i ).appid;
-        return appids;
     }
 
-private:
-    std::vector<Game> games;
+    std::vector<Record> records;
+    std::vector<SappStringArena> arenas;
+    SappAppIdIndex appIndex;
 };
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "sapp/SteamAppPathProvider.h"
+
+// Builds a throwaway Steam install (libraryfolders.vdf, appmanifest_*.acf and install folders laid
+// out like Source / Source 2 games) under the temp directory and points HOME at it for as long as
+// the object lives, so tests and benchmarks don't depend on the Steam install of the machine.
+struct SappFakeSteamTreeOptions {
+    unsigned int libraries = 2;
+    unsigned int manifests = 50;
+    // Every Nth app gets a gameinfo.txt / gameinfo.gi, 0 disables that engine.
+    unsigned int sourceEvery = 3;
+    unsigned int source2Every = 3;
+    // Plain folders created next to the engine folder of every install.
+    unsigned int extraFolders = 2;
+    AppId_t firstAppId = 1000;
+    // Where to build the tree, defaults to a folder in the temp directory.
+    std::filesystem::path root{};
+    // Leave the tree on disk when the object goes away.
+    bool keep = false;
+};
+
+class SappFakeSteamTree {
+public:
+    explicit SappFakeSteamTree(const SappFakeSteamTreeOptions &options = {}, const std::string &name = "sapp_fake_steam")
+        : root(options.root.empty() ? std::filesystem::temp_directory_path() / name : options.root), keep(options.keep) {
+        std::filesystem::remove_all(root);
+
+        if (const char *home = getenv("HOME"))
+            previousHome = home;
+        Activate();
+
+        const auto steam = root / ".steam" / "steam";
+        for (unsigned int i = 0; i < options.libraries; i++)
+            libraries.push_back(i == 0 ? steam.string() : (root / ("library" + std::to_string(i))).string());
+
+        for (const auto &library: libraries)
+            std::filesystem::create_directories(std::filesystem::path(library) / "steamapps" / "common");
+
+        WriteLibraryFolders(steam / "steamapps" / "libraryfolders.vdf");
+
+        for (unsigned int i = 0; i < options.manifests; i++) {
+            const AppId_t appid = options.firstAppId + i;
+            const auto &library = libraries[i % libraries.size()];
+            AddApp(library, appid, "Fake Game " + std::to_string(i), "Fake Game " + std::to_string(i),
+                   options.sourceEvery && i % options.sourceEvery == 0,
+                   options.source2Every && i % options.source2Every == 1,
+                   options.extraFolders);
+        }
+    }
+
+    ~SappFakeSteamTree() {
+        if (previousHome.empty())
+            unsetenv("HOME");
+        else
+            setenv("HOME", previousHome.c_str(), 1);
+        if (!keep) {
+            std::error_code ec;
+            std::filesystem::remove_all(root, ec);
+        }
+    }
+
+    // Points HOME at this tree again, for when several trees are alive at once.
+    void Activate() const {
+        setenv("HOME", root.string().c_str(), 1);
+    }
+
+    // Every manifest of the tree, e.g. to evict them from the page cache.
+    [[nodiscard]] std::vector<std::filesystem::path> ManifestFiles() const {
+        std::vector<std::filesystem::path> files;
+        for (const auto &library: libraries) {
+            for (const auto &entry: std::filesystem::directory_iterator(std::filesystem::path(library) / "steamapps")) {
+                if (entry.path().extension() == ".acf")
+                    files.push_back(entry.path());
+            }
+        }
+        return files;
+    }
+
+    SappFakeSteamTree(const SappFakeSteamTree &) = delete;
+    SappFakeSteamTree &operator=(const SappFakeSteamTree &) = delete;
+
+    void AddApp(const std::string &library, AppId_t appid, const std::string &name, const std::string &installDir,
+                bool source, bool source2, unsigned int extraFolders = 0) {
+        const auto steamapps = std::filesystem::path(library) / "steamapps";
+        std::ofstream(steamapps / ("appmanifest_" + std::to_string(appid) + ".acf"))
+                << "\"AppState\"\n{\n"
+                << "\t\"appid\"\t\t\"" << appid << "\"\n"
+                << "\t\"Universe\"\t\t\"1\"\n"
+                << "\t\"name\"\t\t\"" << name << "\"\n"
+                << "\t\"StateFlags\"\t\t\"4\"\n"
+                << "\t\"installdir\"\t\t\"" << installDir << "\"\n"
+                << "\t\"LastUpdated\"\t\t\"1700000000\"\n"
+                << "\t\"SizeOnDisk\"\t\t\"" << appid * 1024ull << "\"\n"
+                << "\t\"buildid\"\t\t\"" << appid * 7 << "\"\n"
+                << "\t\"InstalledDepots\"\n\t{\n\t\t\"" << appid + 1 << "\"\n\t\t{\n\t\t\t\"manifest\"\t\t\"1234\"\n\t\t\t\"size\"\t\t\"4096\"\n\t\t}\n\t}\n"
+                << "\t\"UserConfig\"\n\t{\n\t\t\"language\"\t\t\"english\"\n\t}\n"
+                << "}\n";
+
+        const auto install = steamapps / "common" / installDir;
+        std::filesystem::create_directories(install);
+        for (unsigned int i = 0; i < extraFolders; i++)
+            std::filesystem::create_directories(install / ("folder" + std::to_string(i)));
+
+        if (source) {
+            std::filesystem::create_directories(install / "hl2");
+            std::ofstream(install / "hl2" / "gameinfo.txt") << "\"GameInfo\"\n{\n\tgame \"" << name << "\"\n}\n";
+        }
+        if (source2) {
+            std::filesystem::create_directories(install / "game" / "mod");
+            std::ofstream(install / "game" / "mod" / "gameinfo.gi") << "\"GameInfo\"\n{\n\tgame \"" << name << "\"\n}\n";
+        }
+        appids.push_back(appid);
+    }
+
+    [[nodiscard]] const std::filesystem::path &Root() const {
+        return root;
+    }
+
+    std::vector<std::string> libraries;
+    std::vector<AppId_t> appids;
+
+private:
+    void WriteLibraryFolders(const std::filesystem::path &file) const {
+        std::ofstream out(file);
+        out << "\"libraryfolders\"\n{\n";
+        for (std::size_t i = 0; i < libraries.size(); i++) {
+            out << "\t\"" << i << "\"\n\t{\n"
+                << "\t\t\"path\"\t\t\"" << libraries[i] << "\"\n"
+                << "\t\t\"label\"\t\t\"\"\n"
+                << "\t\t\"apps\"\n\t\t{\n\t\t}\n"
+                << "\t}\n";
+        }
+        out << "}\n";
+    }
+
+    std::filesystem::path root;
+    std::string previousHome;
+    bool keep;
+};
@@ -1,10 +1,17 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <cstdlib>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <set>
 #include <string>
+#include <thread>
 #include <filesystem>
 #include "sapp/SteamAppPathProvider.h"
+#include "SAPPFixture.h"
 
 char SLASH;
 [[maybe_unused]] auto SLASH_HELPER = wctomb(&SLASH, std::filesystem::path::preferred_separator);
@@ -100,3 +107,1167 @@ TEST(SAPP, searchForSourceGamesUncachedStressTest) {
         }
     }
 }
+
+TEST(SAPP, mappedFileSmallAndLarge) {
+    const auto dir = std::filesystem::temp_directory_path();
+    const std::string small = (dir / "sapp_mapped_small.txt").string();
+    const std::string large = (dir / "sapp_mapped_large.txt").string();
+
+    const std::string smallContents = R"("AppState" { "appid" "220" })";
+    const std::string largeContents(SappMappedFile::smallFileLimit * 3 + 17, 'x');
+    std::ofstream(small, std::ios::binary) << smallContents;
+    std::ofstream(large, std::ios::binary) << largeContents;
+
+    SappMappedFile smallFile(small);
+    ASSERT_TRUE(smallFile.IsOpen());
+    EXPECT_EQ(smallFile.View(), smallContents);
+
+    SappMappedFile largeFile(large);
+    ASSERT_TRUE(largeFile.IsOpen());
+    EXPECT_EQ(largeFile.View(), largeContents);
+
+    SappMappedFile moved(std::move(smallFile));
+    EXPECT_EQ(moved.View(), smallContents);
+    EXPECT_FALSE(smallFile.IsOpen());
+
+    EXPECT_FALSE(SappMappedFile((dir / "sapp_does_not_exist.acf").string()).IsOpen());
+
+    std::filesystem::remove(small);
+    std::filesystem::remove(large);
+}
+
+TEST(SAPP, keyValuesTokenizer) {
+    using TokenType = SappKeyValuesTokenizer::TokenType;
+
+    const std::string_view manifest = R"(// comment with "quotes" and { braces }
+"AppState"
+{
+	"appid"		"220"
+	"UserConfig"
+	{
+		"language"		"english {not a block}"
+	}
+	"name"		"Half-Life 2 \"Remastered\""
+	"installdir"		"Half-Life 2"   [$WIN32]
+	"LastOwner"		"0"
+}
+)";
+
+    static constexpr std::string_view keys[] = {"APPID", "name", "installdir"};
+    std::string_view values[std::size(keys)];
+    EXPECT_EQ(SappKeyValuesTokenizer::FindValues(manifest, "appstate", keys, values), 3u);
+    EXPECT_EQ(values[0], "220");
+    EXPECT_EQ(SappKeyValuesTokenizer::Unescape(values[1]), "Half-Life 2 \"Remastered\"");
+    EXPECT_EQ(values[2], "Half-Life 2");
+
+    SappKeyValuesTokenizer unquoted("GameInfo { FileSystem { SearchPaths { Game |gameinfo_path|. } } }");
+    EXPECT_EQ(unquoted.Next().text, "GameInfo");
+    EXPECT_EQ(unquoted.Next().type, TokenType::BlockBegin);
+
+    // Truncated or malformed input must stop cleanly instead of reading past the buffer.
+    for (std::size_t length = 0; length < manifest.size(); length++) {
+        std::string_view truncated[std::size(keys)];
+        SappKeyValuesTokenizer::FindValues(manifest.substr(0, length), "AppState", keys, truncated);
+    }
+    SappKeyValuesTokenizer broken(R"("AppState" { "appid" "22)");
+    EXPECT_EQ(broken.Next().type, TokenType::String);
+    EXPECT_EQ(broken.Next().type, TokenType::BlockBegin);
+    EXPECT_EQ(broken.Next().type, TokenType::String);
+    EXPECT_EQ(broken.Next().type, TokenType::Error);
+    EXPECT_EQ(broken.Next().type, TokenType::End);
+}
+
+TEST(SAPP, parallelScanMatchesSerialScan) {
+    SappFakeSteamTree tree({.libraries = 3, .manifests = 200});
+
+    SappScanOptions serialOptions{.precacheSourceGames = true, .precacheSource2Games = true};
+    SappScanOptions parallelOptions = serialOptions;
+    parallelOptions.parallelScan = true;
+    parallelOptions.workerCount = 8;
+
+    SteamAppPathProvider serial{serialOptions};
+    SteamAppPathProvider parallel{parallelOptions};
+    ASSERT_EQ(serial.GetNumInstalledApps(), tree.appids.size());
+    ASSERT_EQ(parallel.GetNumInstalledApps(), serial.GetNumInstalledApps());
+
+    std::unique_ptr<uint32_t[]> serialIDs(serial.GetInstalledAppsEX());
+    std::unique_ptr<uint32_t[]> parallelIDs(parallel.GetInstalledAppsEX());
+    for (uint32 i = 0; i < serial.GetNumInstalledApps(); i++) {
+        ASSERT_EQ(serialIDs[i], parallelIDs[i]);
+        EXPECT_EQ(serial.GetAppInstallDirEX(serialIDs[i]).installDir, parallel.GetAppInstallDirEX(parallelIDs[i]).installDir);
+        EXPECT_EQ(serial.BIsSourceGame(serialIDs[i]), parallel.BIsSourceGame(parallelIDs[i]));
+        EXPECT_EQ(serial.BIsSource2Game(serialIDs[i]), parallel.BIsSource2Game(parallelIDs[i]));
+    }
+}
+
+TEST(SAPP, appIdLookupMissIsDefined) {
+    SappFakeSteamTree tree({.manifests = 10});
+    SteamAppPathProvider provider;
+    ASSERT_TRUE(provider.Available());
+
+    EXPECT_FALSE(provider.BIsAppInstalled(999999));
+    EXPECT_EQ(provider.GetAppInstallDirEX(999999).appid, k_uAppIdInvalid);
+    std::string dir;
+    EXPECT_FALSE(provider.GetAppInstallDir(999999, dir));
+    EXPECT_TRUE(dir.empty());
+
+    provider.sortGames(false);
+    for (const auto appid: tree.appids)
+        EXPECT_EQ(provider.GetAppInstallDirEX(appid).appid, appid);
+}
+
+//Every inserted appid must be found at any size, and appids in between must miss. BM_AppIdIndexLookup measures the cost.
+TEST(SAPP, appIdIndexLookupStressTest) {
+    for (const std::size_t count: {10u, 100u, 1000u, 10000u, 50000u}) {
+        std::vector<AppId_t> appids(count);
+        for (std::size_t i = 0; i < count; i++)
+            appids[i] = static_cast<AppId_t>(10 + i * 37);
+
+        SappAppIdIndex index;
+        index.Reset(count);
+        for (std::size_t i = 0; i < count; i++)
+            index.Insert(appids[i], static_cast<uint32>(i));
+
+        for (std::size_t i = 0; i < count; i++) {
+            ASSERT_EQ(index.Find(appids[i]), i);
+            ASSERT_EQ(index.Find(appids[i] + 1), SappAppIdIndex::npos);
+        }
+        EXPECT_EQ(index.Find(k_uAppIdInvalid), SappAppIdIndex::npos);
+        EXPECT_EQ(index.Find(appids.back() + 37), SappAppIdIndex::npos);
+    }
+}
+
+TEST(SAPP, scanCacheReusesUnchangedManifests) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 20});
+    const auto cacheFile = (tree.Root() / "sapp.cache").string();
+
+    SappScanOptions options{.precacheSourceGames = true, .precacheSource2Games = true, .cacheFile = cacheFile};
+    SteamAppPathProvider cold{options};
+    ASSERT_EQ(cold.GetNumInstalledApps(), tree.appids.size());
+    ASSERT_TRUE(std::filesystem::exists(cacheFile));
+#ifndef _WIN32
+    EXPECT_EQ(std::filesystem::status(cacheFile).permissions(), std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+#endif
+
+    // Same size and modification time: the cached record must be used instead of the (now garbage) file.
+    const auto manifest = std::filesystem::path(tree.libraries[0]) / "steamapps" / ("appmanifest_" + std::to_string(tree.appids[0]) + ".acf");
+    const auto writeTime = std::filesystem::last_write_time(manifest);
+    const auto size = std::filesystem::file_size(manifest);
+    std::ofstream(manifest, std::ios::binary | std::ios::trunc) << std::string(size, '?');
+    std::filesystem::last_write_time(manifest, writeTime);
+
+    SteamAppPathProvider warm{options};
+    ASSERT_EQ(warm.GetNumInstalledApps(), cold.GetNumInstalledApps());
+    std::unique_ptr<uint32_t[]> coldIDs(cold.GetInstalledAppsEX());
+    std::unique_ptr<uint32_t[]> warmIDs(warm.GetInstalledAppsEX());
+    for (uint32 i = 0; i < cold.GetNumInstalledApps(); i++) {
+        ASSERT_EQ(coldIDs[i], warmIDs[i]);
+        EXPECT_EQ(cold.GetAppInstallDirEX(coldIDs[i]).gameName, warm.GetAppInstallDirEX(warmIDs[i]).gameName);
+        EXPECT_EQ(cold.BIsSourceGame(coldIDs[i]), warm.BIsSourceGame(warmIDs[i]));
+        EXPECT_EQ(cold.BIsSource2Game(coldIDs[i]), warm.BIsSource2Game(warmIDs[i]));
+    }
+
+    // A changed manifest is reparsed, a new one is picked up.
+    std::filesystem::remove(manifest);
+    tree.AddApp(tree.libraries[0], tree.appids[0], "Renamed Game", "Renamed Game", false, true);
+    tree.AddApp(tree.libraries[1], 90000, "New Game", "New Game", true, false);
+
+    SteamAppPathProvider updated{options};
+    EXPECT_EQ(updated.GetNumInstalledApps(), cold.GetNumInstalledApps() + 1);
+    EXPECT_EQ(updated.GetAppInstallDirEX(tree.appids[0]).gameName, "Renamed Game");
+    EXPECT_TRUE(updated.BIsSource2Game(tree.appids[0]));
+    EXPECT_FALSE(updated.BIsSourceGame(tree.appids[0]));
+    EXPECT_TRUE(updated.BIsSourceGame(90000));
+
+    // A corrupt cache is ignored and rewritten.
+    std::ofstream(cacheFile, std::ios::binary | std::ios::trunc) << "SAPC garbage";
+    SteamAppPathProvider recovered{options};
+    EXPECT_EQ(recovered.GetNumInstalledApps(), updated.GetNumInstalledApps());
+}
+
+#ifdef __linux__
+TEST(SAPP, watchAppliesManifestChanges) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 10});
+    SteamAppPathProvider provider{SappScanOptions{.precacheSourceGames = true, .precacheSource2Games = true, .watch = true}};
+    ASSERT_GE(provider.GetWatchDescriptor(), 0);
+    ASSERT_EQ(provider.GetNumInstalledApps(), tree.appids.size());
+
+    std::vector<SappAppChange> callbackChanges;
+    // Callbacks may call back into the provider.
+    provider.SetChangeCallback([&callbackChanges, &provider](const SappAppChange &change) {
+        callbackChanges.push_back(change);
+        provider.sortGames(false);
+        EXPECT_EQ(provider.PollChanges(0), 0u);
+    });
+
+    tree.AddApp(tree.libraries[1], 50000, "Watched Game", "Watched Game", true, false);
+    EXPECT_EQ(provider.PollChanges(1000), 1u);
+    ASSERT_EQ(callbackChanges.size(), 1u);
+    EXPECT_EQ(callbackChanges[0].type, SappAppChange::Type::Installed);
+    EXPECT_TRUE(provider.BIsAppInstalled(50000));
+    EXPECT_TRUE(provider.BIsSourceGame(50000));
+
+    tree.AddApp(tree.libraries[1], 50000, "Watched Game Renamed", "Watched Game", true, false);
+    std::vector<SappAppChange> changes;
+    EXPECT_EQ(provider.PollChanges(1000, &changes), 1u);
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].type, SappAppChange::Type::Updated);
+    EXPECT_EQ(provider.GetAppInstallDirEX(50000).gameName, "Watched Game Renamed");
+
+    const auto removedAppId = tree.appids[3];
+    const auto library = provider.GetAppInstallDirEX(removedAppId).library;
+    std::filesystem::remove(std::filesystem::path(library) / ("appmanifest_" + std::to_string(removedAppId) + ".acf"));
+    changes.clear();
+    EXPECT_EQ(provider.PollChanges(1000, &changes), 1u);
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0].type, SappAppChange::Type::Removed);
+    EXPECT_FALSE(provider.BIsAppInstalled(removedAppId));
+    EXPECT_EQ(provider.GetNumInstalledApps(), 10u);
+    for (const auto appid: tree.appids)
+        EXPECT_EQ(provider.BIsAppInstalled(appid), appid != removedAppId);
+
+    EXPECT_EQ(provider.PollChanges(0), 0u);
+
+    // Writers don't queue up behind a poll that is waiting for events.
+    auto waiting = std::async(std::launch::async, [&provider] { return provider.PollChanges(-1); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto start = std::chrono::steady_clock::now();
+    provider.sortGames(false);
+    provider.SetChangeCallback({});
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    tree.AddApp(tree.libraries[0], 50001, "Late Game", "Late Game", true, false);
+    EXPECT_EQ(waiting.get(), 1u);
+    EXPECT_TRUE(provider.BIsAppInstalled(50001));
+}
+#endif
+
+#ifdef __linux__
+TEST(SAPP, watchKeepsArenaBounded) {
+    SappFakeSteamTree tree({.libraries = 1, .manifests = 10});
+    SteamAppPathProvider provider{SappScanOptions{.watch = true}};
+    tree.AddApp(tree.libraries[0], 60000, "Renamed", "Renamed", false, false);
+    ASSERT_EQ(provider.PollChanges(1000), 1u);
+
+    // Rewriting a manifest without changing it is no change.
+    tree.AddApp(tree.libraries[0], 60000, "Renamed", "Renamed", false, false);
+    EXPECT_EQ(provider.PollChanges(1000), 0u);
+
+    // Replaced names are dropped from the arena once they make up half of it.
+    for (int i = 0; i < 200; i++) {
+        tree.AddApp(tree.libraries[0], 60000, std::string(4000, static_cast<char>('a' + i % 26)), "Renamed", false, false);
+        ASSERT_EQ(provider.PollChanges(1000), 1u);
+    }
+    EXPECT_LT(provider.GetStorageBytes(), 4 * SappStringArena::chunkSize);
+    EXPECT_EQ(provider.GetAppInstallDirEX(60000).gameName, std::string(4000, static_cast<char>('a' + 199 % 26)));
+    EXPECT_EQ(provider.FindAppByPath(provider.GetAppInstallDirEX(60000).installPath), 60000u);
+    EXPECT_EQ(provider.FindAppByPath(provider.GetAppInstallDirEX(tree.appids[0]).installPath), tree.appids[0]);
+}
+#endif
+
+#ifdef __linux__
+TEST(SAPP, watchPatchesIndices) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 600, .extraFolders = 0});
+    const SappScanOptions options{.precacheSourceGames = true, .precacheSource2Games = true};
+    SteamAppPathProvider watched{SappScanOptions{.precacheSourceGames = true, .precacheSource2Games = true, .watch = true}};
+
+    // The lists and indices patched change by change have to answer like those of a fresh scan.
+    const auto expectSameAsFreshScan = [&] {
+        while (watched.PollChanges(200) > 0) {
+        }
+        SteamAppPathProvider fresh{options};
+        const auto sortedIds = [](const SteamAppPathProvider &provider) {
+            const auto snapshot = provider.GetSnapshot();
+            std::vector<AppId_t> ids(snapshot->GetAppIds().begin(), snapshot->GetAppIds().end());
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        const auto ids = sortedIds(fresh);
+        ASSERT_EQ(sortedIds(watched), ids);
+        for (const auto appid: ids) {
+            const auto game = fresh.GetAppInstallDirEX(appid);
+            EXPECT_EQ(watched.GetAppInstallDirEX(appid).GetName(), game.GetName());
+            EXPECT_EQ(watched.FindAppByPath(std::string(game.GetInstallPath()) + "/sub"), appid);
+            EXPECT_EQ(watched.BIsSourceGame(appid), fresh.BIsSourceGame(appid));
+            EXPECT_EQ(watched.BIsSource2Game(appid), fresh.BIsSource2Game(appid));
+        }
+        for (const auto query: {"fake", "game 1", "ame 42", "renamed", "moved", "59", "zz"})
+            EXPECT_EQ(watched.FindAppsByName(query), fresh.FindAppsByName(query)) << query;
+    };
+
+    const std::vector<AppId_t> initial = tree.appids;
+    const auto libraryOf = [&](std::size_t i) { return tree.libraries[i % tree.libraries.size()]; };
+    for (std::size_t i = 0; i < 100; i += 2)
+        tree.AddApp(libraryOf(i), initial[i], "Renamed Game " + std::to_string(i), "Fake Game " + std::to_string(i), i % 4 == 0, false, 0);
+    expectSameAsFreshScan();
+
+    for (std::size_t i = 200; i < 240; i++)
+        std::filesystem::remove(std::filesystem::path(libraryOf(i)) / "steamapps" / ("appmanifest_" + std::to_string(initial[i]) + ".acf"));
+    expectSameAsFreshScan();
+
+    for (AppId_t appid = 90000; appid < 90030; appid++)
+        tree.AddApp(tree.libraries[appid % 2], appid, "New Game " + std::to_string(appid), "New Game " + std::to_string(appid), appid % 3 == 0, false, 0);
+    expectSameAsFreshScan();
+
+    for (std::size_t i = 300; i < 320; i++)
+        tree.AddApp(libraryOf(i), initial[i], "Moved Game " + std::to_string(i), "Moved Game " + std::to_string(i), false, true, 0);
+    expectSameAsFreshScan();
+}
+#endif
+
+TEST(SAPP, lazyEngineDetectionIsMemoized) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 60});
+    SteamAppPathProvider uncached;
+    SteamAppPathProvider lazy{SappScanOptions{.lazyEngineDetection = true}};
+    ASSERT_EQ(lazy.GetNumInstalledApps(), uncached.GetNumInstalledApps());
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 8; t++) {
+        readers.emplace_back([&] {
+            for (const auto appid: tree.appids) {
+                EXPECT_EQ(lazy.BIsSourceGame(appid), uncached.BIsSourceGame(appid));
+                EXPECT_EQ(lazy.BIsSource2Game(appid), uncached.BIsSource2Game(appid));
+            }
+        });
+    }
+    for (auto &reader: readers)
+        reader.join();
+
+    // The answer is remembered, the install folder isn't looked at again.
+    const auto appid = tree.appids[0];
+    ASSERT_TRUE(lazy.BIsSourceGame(appid));
+    std::string dir;
+    ASSERT_TRUE(lazy.GetAppInstallDir(appid, dir));
+    std::filesystem::remove_all(std::filesystem::path(dir) / "hl2");
+    EXPECT_TRUE(lazy.BIsSourceGame(appid));
+    EXPECT_FALSE(uncached.BIsSourceGame(appid));
+
+    lazy.sortGames(false);
+    EXPECT_TRUE(lazy.BIsSourceGame(appid));
+}
+
+#ifdef __linux__
+//Both probes must agree, and the native probe should need far fewer filesystem calls.
+TEST(SAPP, engineProbeSyscallCounts) {
+    SappFakeSteamTree tree({.libraries = 1, .manifests = 30, .extraFolders = 40});
+    SteamAppPathProvider provider;
+    ASSERT_TRUE(provider.Available());
+
+    SappProbeCounters portable;
+    SappProbeCounters native;
+    for (const auto appid: tree.appids) {
+        std::string dir;
+        ASSERT_TRUE(provider.GetAppInstallDir(appid, dir));
+        for (const auto &[source, source2]: {std::pair{true, false}, std::pair{false, true}, std::pair{true, true}}) {
+            EXPECT_EQ(SappEngineProbe::ProbePortable(dir, source, source2, &portable),
+                      SappEngineProbe::ProbeNative(dir, source, source2, &native));
+        }
+    }
+    EXPECT_LT(native.Total(), portable.Total());
+}
+#endif
+
+TEST(SAPP, arenaBackedGameStorage) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 2000, .sourceEvery = 0, .source2Every = 0, .extraFolders = 0});
+    SteamAppPathProvider provider;
+    ASSERT_EQ(provider.GetNumInstalledApps(), tree.appids.size());
+
+    // Snapshots hand out views into their arena, libraries are stored once.
+    const auto snapshot = provider.GetSnapshot();
+    const auto &first = snapshot->GetAppInstallDirEX(tree.appids[0]);
+    const auto &third = snapshot->GetAppInstallDirEX(tree.appids[2]);
+    EXPECT_EQ(first.GetLibrary().data(), third.GetLibrary().data());
+    const auto icon = (std::filesystem::path(tree.libraries[0]) / "appcache" / "librarycache" / (std::to_string(tree.appids[0]) + "_icon.jpg")).string();
+    EXPECT_EQ(first.GetIcon(), icon);
+
+    // The provider hands out owning copies.
+    const std::string name = provider.GetAppInstallDirEX(tree.appids[0]).gameName;
+    EXPECT_EQ(name, first.GetName());
+    EXPECT_EQ(provider.GetAppInstallDirEX(tree.appids[0]).icon, icon);
+    EXPECT_EQ(provider.GetAppInstallDirEX(424242).appid, k_uAppIdInvalid);
+    EXPECT_TRUE(provider.GetAppInstallDirEX(424242).icon.empty());
+
+    // What the same games cost with four std::strings per Game.
+    std::size_t legacyBytes = 0;
+    for (const auto &game: snapshot->GetGames()) {
+        legacyBytes += 4 * sizeof(std::string) + sizeof(AppId_t);
+        for (const auto length: {game.GetName().size(), game.GetLibrary().size(), game.GetInstallDir().size(), game.GetIcon().size()})
+            legacyBytes += length > 15 ? length + 1 : 0;
+    }
+    EXPECT_LT(provider.GetStorageBytes(), legacyBytes);
+}
+
+#if SAPP_ENABLE_SCAN_STATS
+TEST(SAPP, scanStatsAndTrace) {
+    SappFakeSteamTree tree({.libraries = 3, .manifests = 30});
+
+    SappScanStats stats;
+    std::mutex traceLock;
+    int depth = 0;
+    std::size_t events = 0;
+    SappScanOptions options{.precacheSourceGames = true, .precacheSource2Games = true, .parallelScan = true, .workerCount = 4, .stats = &stats};
+    options.trace = [&](const SappTraceEvent &event) {
+        std::scoped_lock lock(traceLock);
+        depth += event.begin ? 1 : -1;
+        events++;
+    };
+
+    SteamAppPathProvider provider{options};
+    ASSERT_EQ(provider.GetNumInstalledApps(), tree.appids.size());
+    EXPECT_EQ(depth, 0);
+    EXPECT_GT(events, tree.appids.size() * 2);
+
+    ASSERT_EQ(stats.libraries.size(), tree.libraries.size());
+    uint32 manifests = 0;
+    for (const auto &library: stats.libraries)
+        manifests += library.manifests;
+    EXPECT_EQ(manifests, tree.appids.size());
+
+    EXPECT_EQ(stats[SappScanPhase::LibraryFolders].filesOpened, 1u);
+    EXPECT_EQ(stats[SappScanPhase::ManifestRead].filesOpened, tree.appids.size());
+    EXPECT_GT(stats[SappScanPhase::ManifestRead].bytesRead, 0u);
+    EXPECT_GE(stats[SappScanPhase::ManifestListing].directoryEntries, tree.appids.size());
+    EXPECT_GT(stats[SappScanPhase::EngineProbe].statCalls, 0u);
+    EXPECT_GT(stats.totalTime.count(), 0);
+    EXPECT_NE(stats.ToString().find("manifest parse"), std::string::npos);
+}
+#endif
+
+TEST(SAPP, asyncScanStreamsGames) {
+    SappFakeSteamTree tree({.libraries = 3, .manifests = 90});
+    SteamAppPathProvider reference{true, true};
+
+    SappAsyncScan scan(SappScanOptions{.precacheSourceGames = true, .precacheSource2Games = true, .workerCount = 3});
+    std::vector<SappScanEvent> events;
+    do {
+        scan.Poll(events, 1000);
+    } while (!scan.IsDone());
+    scan.Poll(events);
+
+    ASSERT_FALSE(events.empty());
+    EXPECT_EQ(events.back().type, SappScanEvent::Type::Completed);
+    std::set<AppId_t> discovered;
+    std::size_t classified = 0;
+    for (const auto &event: events) {
+        if (event.type == SappScanEvent::Type::GameDiscovered) {
+            EXPECT_TRUE(discovered.insert(event.appid).second);
+            EXPECT_EQ(event.library, reference.GetAppInstallDirEX(event.appid).GetLibrary());
+        } else if (event.type == SappScanEvent::Type::EngineClassified) {
+            // Engines are only reported after the game itself.
+            EXPECT_TRUE(discovered.contains(event.appid));
+            EXPECT_EQ(event.isSource, reference.BIsSourceGame(event.appid));
+            EXPECT_EQ(event.isSource2, reference.BIsSource2Game(event.appid));
+            classified++;
+        }
+    }
+    EXPECT_EQ(discovered.size(), reference.GetNumInstalledApps());
+    EXPECT_EQ(classified, reference.GetNumInstalledApps());
+
+    const auto provider = scan.Wait();
+    ASSERT_TRUE(provider);
+    ASSERT_EQ(provider->GetNumInstalledApps(), reference.GetNumInstalledApps());
+    for (uint32 i = 0; i < reference.GetNumInstalledApps(); i++) {
+        const auto game = reference.GetAppInstallDirEX(tree.appids[i]);
+        const auto &scanned = provider->GetAppInstallDirEX(tree.appids[i]);
+        EXPECT_EQ(scanned.GetName(), game.GetName());
+        EXPECT_EQ(scanned.GetInstallDir(), game.GetInstallDir());
+        EXPECT_EQ(provider->BIsSourceGame(tree.appids[i]), reference.BIsSourceGame(tree.appids[i]));
+        EXPECT_EQ(provider->BIsSource2Game(tree.appids[i]), reference.BIsSource2Game(tree.appids[i]));
+    }
+    std::vector<AppId_t> expected(reference.GetNumInstalledApps()), actual(provider->GetNumInstalledApps());
+    reference.GetInstalledApps(expected.data(), expected.size());
+    provider->GetInstalledApps(actual.data(), actual.size());
+    EXPECT_EQ(actual, expected);
+}
+
+TEST(SAPP, asyncScanCancel) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 200});
+    std::mutex lock;
+    std::vector<SappScanEvent::Type> types;
+    SappAsyncScan *self = nullptr;
+    std::mutex started;
+    started.lock();
+    SappAsyncScan scan({}, [&](const SappScanEvent &event) {
+        std::scoped_lock guard(lock);
+        types.push_back(event.type);
+        if (event.type == SappScanEvent::Type::GameDiscovered) {
+            started.lock();
+            self->Cancel();
+            started.unlock();
+        }
+    });
+    self = &scan;
+    started.unlock();
+
+    EXPECT_EQ(scan.Wait(), nullptr);
+    while (!scan.IsDone())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::scoped_lock guard(lock);
+    ASSERT_FALSE(types.empty());
+    EXPECT_EQ(types.back(), SappScanEvent::Type::Cancelled);
+    EXPECT_LT(types.size(), tree.appids.size());
+}
+
+TEST(SAPP, snapshotsSurviveRefresh) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 40});
+    SteamAppPathProvider provider;
+    const auto before = provider.GetSnapshot();
+    const auto &game = before->GetAppInstallDirEX(tree.appids[0]);
+    const std::string name(game.GetName());
+
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                const auto snapshot = provider.GetSnapshot();
+                for (const auto appid: tree.appids) {
+                    std::string dir;
+                    EXPECT_TRUE(snapshot->GetAppInstallDir(appid, dir));
+                    EXPECT_EQ(snapshot->GetAppInstallDirEX(appid).appid, appid);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 20; i++) {
+        provider.sortGames(i % 2);
+        provider.Refresh();
+    }
+    stop = true;
+    for (auto &reader: readers)
+        reader.join();
+
+    // Apps installed after a snapshot was taken only show up in later ones.
+    tree.AddApp(tree.libraries[1], 99999, "Late Game", "Late Game", false, false);
+    provider.Refresh();
+    EXPECT_TRUE(provider.BIsAppInstalled(99999));
+    EXPECT_FALSE(before->BIsAppInstalled(99999));
+    EXPECT_NE(provider.GetSnapshot(), before);
+    EXPECT_EQ(game.GetName(), name);
+}
+
+TEST(SAPP, steamRootDiscovery) {
+    SappFakeSteamTree tree({.libraries = 1, .manifests = 5});
+    const auto steam = tree.libraries[0];
+
+    // A Flatpak install in another home is found without looking at any process.
+    const auto flatpakHome = tree.Root() / "flatpak_home";
+    const auto flatpakRoot = flatpakHome / ".var" / "app" / "com.valvesoftware.Steam" / ".local" / "share";
+    std::filesystem::create_directories(flatpakRoot);
+    std::filesystem::create_directory_symlink(steam, flatpakRoot / "Steam");
+    setenv("HOME", flatpakHome.c_str(), 1);
+    {
+        SappScanStats stats;
+        SteamAppPathProvider provider{SappScanOptions{.stats = &stats}};
+        EXPECT_EQ(provider.GetNumInstalledApps(), 5u);
+#if SAPP_ENABLE_SCAN_STATS
+        EXPECT_EQ(stats[SappScanPhase::SteamRoot].directoryEntries, 0u);
+        EXPECT_LE(stats[SappScanPhase::SteamRoot].statCalls, 5u);
+#endif
+    }
+    // The locations are all looked at again, so an install added in the meantime is found, but still without processes.
+    {
+        SappScanStats stats;
+        SteamAppPathProvider provider{SappScanOptions{.stats = &stats}};
+        EXPECT_EQ(provider.GetNumInstalledApps(), 5u);
+#if SAPP_ENABLE_SCAN_STATS
+        EXPECT_EQ(stats[SappScanPhase::SteamRoot].directoryEntries, 0u);
+        EXPECT_LE(stats[SappScanPhase::SteamRoot].statCalls, 4u);
+#endif
+    }
+
+    // SAPP_STEAM_ROOT wins over HOME, and a missing HOME doesn't crash.
+    const auto emptyHome = tree.Root() / "empty_home";
+    std::filesystem::create_directories(emptyHome);
+    setenv("HOME", emptyHome.c_str(), 1);
+    setenv("SAPP_STEAM_ROOT", steam.c_str(), 1);
+    EXPECT_EQ(SteamAppPathProvider().GetNumInstalledApps(), 5u);
+    unsetenv("HOME");
+    EXPECT_EQ(SteamAppPathProvider().GetNumInstalledApps(), 5u);
+    unsetenv("SAPP_STEAM_ROOT");
+    EXPECT_NO_THROW((void)SteamAppPathProvider().GetNumInstalledApps());
+
+    // Without any install the processes are looked at once, the miss is remembered too.
+    setenv("HOME", emptyHome.c_str(), 1);
+    EXPECT_EQ(SteamAppPathProvider().GetNumInstalledApps(), 0u);
+    {
+        SappScanStats stats;
+        SteamAppPathProvider provider{SappScanOptions{.stats = &stats}};
+        EXPECT_EQ(provider.GetNumInstalledApps(), 0u);
+#if SAPP_ENABLE_SCAN_STATS
+        EXPECT_EQ(stats[SappScanPhase::SteamRoot].directoryEntries, 0u);
+#endif
+    }
+    unsetenv("HOME");
+}
+
+TEST(SAPP, enumerationViews) {
+    SappFakeSteamTree tree({.libraries = 3, .manifests = 45});
+    SteamAppPathProvider provider{true, true};
+    const auto snapshot = provider.GetSnapshot();
+
+    const auto appids = snapshot->GetAppIds();
+    const auto games = snapshot->GetGames();
+    ASSERT_EQ(appids.size(), provider.GetNumInstalledApps());
+    ASSERT_EQ(games.size(), appids.size());
+    std::vector<AppId_t> copied(appids.size() + 5);
+    EXPECT_EQ(provider.GetInstalledApps(copied.data(), copied.size()), appids.size());
+    EXPECT_EQ(provider.GetInstalledApps(copied.data(), 3), 3u);
+    for (std::size_t i = 0; i < appids.size(); i++) {
+        EXPECT_EQ(games[i].appid, appids[i]);
+        EXPECT_EQ(copied[i], appids[i]);
+    }
+
+    std::size_t source = 0, source2 = 0, inLibraries = 0;
+    for (const auto &game: snapshot->GetSourceGames()) {
+        EXPECT_TRUE(provider.BIsSourceGame(game.appid));
+        source++;
+    }
+    for (const auto &game: snapshot->GetSource2Games()) {
+        EXPECT_TRUE(provider.BIsSource2Game(game.appid));
+        source2++;
+    }
+    EXPECT_EQ(source, 15u);
+    EXPECT_EQ(source2, 15u);
+    for (const auto &library: tree.libraries) {
+        const auto steamapps = library + "/steamapps";
+        for (const auto &game: snapshot->GetGamesInLibrary(steamapps)) {
+            EXPECT_EQ(game.GetLibrary(), steamapps);
+            inLibraries++;
+        }
+    }
+    EXPECT_EQ(inLibraries, games.size());
+
+    // Sorting publishes a new snapshot, the one held keeps its order.
+    provider.sortGames(false);
+    const auto sorted = provider.GetSnapshot();
+    EXPECT_TRUE(std::is_sorted(sorted->GetAppIds().begin(), sorted->GetAppIds().end(), std::greater<>()));
+    EXPECT_EQ(snapshot->GetAppIds().data(), appids.data());
+}
+
+TEST(SAPP, batchInstallDirs) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 20});
+    SteamAppPathProvider provider;
+
+    std::vector<AppId_t> appids(tree.appids.begin(), tree.appids.end());
+    appids.insert(appids.begin() + 5, 424242);
+    std::vector<uint32> offsets(appids.size() + 1);
+    std::unique_ptr<bool[]> found(new bool[appids.size()]);
+    const std::span<bool> flags(found.get(), appids.size());
+
+    // Too small: only the offsets and flags are complete.
+    std::vector<char> buffer(16);
+    const auto size = provider.GetAppInstallDirs(appids, buffer, offsets, flags);
+    ASSERT_GT(size, buffer.size());
+    EXPECT_EQ(offsets.back(), size);
+
+    buffer.resize(size);
+    EXPECT_EQ(provider.GetAppInstallDirs(appids, buffer, offsets, flags), size);
+    for (std::size_t i = 0; i < appids.size(); i++) {
+        const std::string_view path(buffer.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        std::string expected;
+        EXPECT_EQ(flags[i], provider.GetAppInstallDir(appids[i], expected));
+        EXPECT_EQ(path, expected);
+        EXPECT_EQ(path, provider.GetAppInstallDirEX(appids[i]).GetInstallPath());
+    }
+    EXPECT_FALSE(flags[5]);
+    EXPECT_EQ(provider.GetAppInstallDirEX(appids[0]).GetInstallDir(), "Fake Game 0");
+}
+
+TEST(SAPP, findAppByPath) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 30});
+    // The second library is listed through a symlink.
+    const std::filesystem::path linked = tree.libraries[1];
+    const auto real = tree.Root() / "library1_real";
+    std::filesystem::rename(linked, real);
+    std::filesystem::create_directory_symlink(real, linked);
+    SteamAppPathProvider provider;
+    ASSERT_EQ(provider.GetNumInstalledApps(), tree.appids.size());
+
+    for (const auto appid: tree.appids) {
+        std::string dir;
+        ASSERT_TRUE(provider.GetAppInstallDir(appid, dir));
+        EXPECT_EQ(provider.FindAppByPath(dir), appid);
+        EXPECT_EQ(provider.FindAppByPath(dir + "/"), appid);
+        EXPECT_EQ(provider.FindAppByPath(dir + "/hl2/gameinfo.txt"), appid);
+    }
+
+    // "Fake Game 1" must not claim the files of "Fake Game 10" or the other way round.
+    const auto common = std::filesystem::path(tree.libraries[0]) / "steamapps" / "common";
+    EXPECT_EQ(provider.FindAppByPath((common / "Fake Game 10" / "bin").string()), tree.appids[10]);
+    EXPECT_EQ(provider.FindAppByPath((common / "Fake Game 1" / "bin").string()), k_uAppIdInvalid);
+    EXPECT_EQ(provider.FindAppByPath((common / "Fake Game 2" / "bin").string()), tree.appids[2]);
+    EXPECT_EQ(provider.FindAppByPath((common / "Fake Game 2-extra").string()), k_uAppIdInvalid);
+    EXPECT_EQ(provider.FindAppByPath(common.string()), k_uAppIdInvalid);
+    EXPECT_EQ(provider.FindAppByPath("/nowhere/steamapps/common/Fake Game 2"), k_uAppIdInvalid);
+    EXPECT_EQ(provider.FindAppByPath(""), k_uAppIdInvalid);
+
+    // The resolved form of the symlinked library works as well.
+    EXPECT_EQ(provider.FindAppByPath((real / "steamapps" / "common" / "Fake Game 1" / "a.vpk").string()), tree.appids[1]);
+}
+
+TEST(SAPP, findAppsByName) {
+    SappFakeSteamTree tree({.libraries = 1, .manifests = 0});
+    const std::vector<std::pair<AppId_t, std::string>> apps = {
+            {220, "Half-Life 2"}, {380, "Half-Life 2: Episode One"}, {400, "Portal"}, {620, "Portal 2"},
+            {550, "Left 4 Dead 2"}, {730, "Counter-Strike 2"}, {440, "Team Fortress 2"}, {1000, "Immortal Planet"}};
+    for (const auto &[appid, name]: apps)
+        tree.AddApp(tree.libraries[0], appid, name, "app" + std::to_string(appid), false, false);
+    SteamAppPathProvider provider;
+    ASSERT_EQ(provider.GetNumInstalledApps(), apps.size());
+
+    using Ids = std::vector<AppId_t>;
+    EXPECT_EQ(provider.FindAppsByName("portal"), (Ids{400, 620}));
+    EXPECT_EQ(provider.FindAppsByName("HALF-life"), (Ids{220, 380}));
+    EXPECT_EQ(provider.FindAppsByName("episode"), (Ids{380}));
+    EXPECT_EQ(provider.FindAppsByName("life"), (Ids{220, 380}));
+    EXPECT_EQ(provider.FindAppsByName("ortal"), (Ids{1000, 400, 620}));
+    EXPECT_EQ(provider.FindAppsByName("2"), (Ids{730, 220, 380, 550, 620, 440}));
+    EXPECT_EQ(provider.FindAppsByName("Portal", 1), (Ids{400}));
+    EXPECT_EQ(provider.FindAppsByName("or"), Ids{});
+    EXPECT_EQ(provider.FindAppsByName("zzz"), Ids{});
+    EXPECT_EQ(provider.FindAppsByName(""), Ids{});
+
+    // Found once the new app is in a published snapshot.
+    tree.AddApp(tree.libraries[0], 1200, "Portal Reloaded", "app1200", false, false);
+    provider.Refresh();
+    EXPECT_EQ(provider.FindAppsByName("portal"), (Ids{400, 620, 1200}));
+}
+
+TEST(SAPP, manifestFieldProjection) {
+    using Field = SappManifestField;
+    using Parser = SappManifestParser<Field::SizeOnDisk, Field::AppId, Field::StateFlags, Field::BuildId, Field::LastUpdated>;
+    static_assert(sizeof(SappManifestRecord<Field::AppId, Field::SizeOnDisk>) == 16);
+
+    const std::string_view manifest = R"("AppState"
+{
+	"AppID"		"220"
+	"InstalledDepots" { "221" { "SizeOnDisk" "1" } }
+	"sizeondisk"		"4294967296"
+	"StateFlags"		"4"
+	"buildid"		"not a number"
+}
+)";
+    Parser::Record record;
+    const auto parsed = Parser::Parse(manifest, record);
+    EXPECT_EQ(parsed, Parser::Bit<Field::AppId> | Parser::Bit<Field::SizeOnDisk> | Parser::Bit<Field::StateFlags>);
+    EXPECT_EQ(record.Get<Field::AppId>(), 220u);
+    EXPECT_EQ(record.Get<Field::SizeOnDisk>(), 4294967296ull);
+    EXPECT_EQ(record.Get<Field::StateFlags>(), 4u);
+    EXPECT_EQ(record.Get<Field::BuildId>(), 0u);
+    for (std::size_t length = 0; length < manifest.size(); length++)
+        Parser::Parse(manifest.substr(0, length), record);
+
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 30});
+    SteamAppPathProvider provider;
+    const SappManifestTable<Field::AppId, Field::SizeOnDisk, Field::BuildId, Field::InstallDir> table;
+    ASSERT_EQ(table.Records().size(), tree.appids.size());
+    for (const auto appid: tree.appids) {
+        const auto found = table.Find(appid);
+        ASSERT_NE(found, nullptr);
+        EXPECT_EQ(found->Get<Field::SizeOnDisk>(), appid * 1024ull);
+        EXPECT_EQ(found->Get<Field::BuildId>(), appid * 7);
+        EXPECT_EQ(found->Get<Field::InstallDir>(), provider.GetAppInstallDirEX(appid).GetInstallDir());
+    }
+    EXPECT_EQ(table.Find(424242), nullptr);
+
+    const SappManifestTable<Field::AppId> appids;
+    EXPECT_EQ(appids.Records().size(), tree.appids.size());
+    EXPECT_LT(appids.GetStorageBytes(), provider.GetStorageBytes());
+}
+
+TEST(SAPP, multipleSteamRoots) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 10});
+    const auto home = tree.Root();
+
+    // ~/.local/share/Steam is the native install again, under another path.
+    std::filesystem::create_directories(home / ".local" / "share");
+    std::filesystem::create_directory_symlink(tree.libraries[0], home / ".local" / "share" / "Steam");
+
+    // A Flatpak install with a library of its own, sharing the second native library through a symlink.
+    const auto flatpak = home / ".var" / "app" / "com.valvesoftware.Steam" / ".local" / "share" / "Steam";
+    std::filesystem::create_directories(flatpak / "steamapps" / "common");
+    std::filesystem::create_directory_symlink(tree.libraries[1], home / "shared_library");
+    std::ofstream(flatpak / "steamapps" / "libraryfolders.vdf")
+            << "\"libraryfolders\"\n{\n"
+            << "\t\"0\"\n\t{\n\t\t\"path\"\t\t\"" << flatpak.string() << "\"\n\t}\n"
+            << "\t\"1\"\n\t{\n\t\t\"path\"\t\t\"" << (home / "shared_library").string() << "\"\n\t}\n"
+            << "}\n";
+    tree.AddApp(flatpak.string(), 50000, "Flatpak Game", "Flatpak Game", true, false);
+
+    const auto cacheFile = (home / "sapp.cache").string();
+    for (const bool parallel: {false, true}) {
+        SappScanStats stats;
+        SteamAppPathProvider provider{SappScanOptions{.parallelScan = parallel, .stats = &stats, .cacheFile = cacheFile}};
+        const auto snapshot = provider.GetSnapshot();
+        ASSERT_EQ(snapshot->GetSteamRoots().size(), 2u);
+        EXPECT_EQ(snapshot->GetSteamRoots()[0], tree.libraries[0]);
+        EXPECT_EQ(snapshot->GetSteamRoots()[1], flatpak.string());
+        EXPECT_EQ(provider.GetNumInstalledApps(), tree.appids.size());
+#if SAPP_ENABLE_SCAN_STATS
+        EXPECT_EQ(stats.libraries.size(), 3u);
+#endif
+
+        for (const auto &game: snapshot->GetGames()) {
+            const bool fromFlatpak = game.appid == 50000;
+            EXPECT_EQ(game.GetRoot(), fromFlatpak ? 1u : 0u);
+            EXPECT_TRUE(game.GetIcon().starts_with(std::string(snapshot->GetSteamRoots()[game.GetRoot()])));
+        }
+        EXPECT_TRUE(provider.BIsSourceGame(50000));
+    }
+
+    SappAsyncScan scan;
+    const auto scanned = scan.Wait();
+    ASSERT_NE(scanned, nullptr);
+    EXPECT_EQ(scanned->GetNumInstalledApps(), tree.appids.size());
+    EXPECT_EQ(scanned->GetAppInstallDirEX(50000).GetRoot(), 1u);
+}
+
+TEST(SAPP, sharedSnapshot) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 40});
+    const auto path = (tree.Root() / "sapp.snapshot").string();
+    EXPECT_FALSE(SappSharedSnapshot(path).Available());
+
+    SteamAppPathProvider provider{SappScanOptions{.lazyEngineDetection = true, .sharedSnapshotFile = path}};
+    SappSharedSnapshot shared(path);
+    ASSERT_TRUE(shared.Available());
+    EXPECT_EQ(shared.Generation(), 1u);
+    EXPECT_FALSE(shared.IsStale());
+    ASSERT_EQ(shared.GetNumInstalledApps(), provider.GetNumInstalledApps());
+    EXPECT_EQ(shared.GetSteamRoot(0), provider.GetSnapshot()->GetSteamRoots()[0]);
+
+    std::vector<AppId_t> appids(shared.GetNumInstalledApps());
+    shared.GetInstalledApps(appids.data(), static_cast<uint32>(appids.size()));
+    EXPECT_TRUE(std::equal(appids.begin(), appids.end(), provider.GetSnapshot()->GetAppIds().begin()));
+    for (const auto appid: tree.appids) {
+        const auto game = shared.Find(appid);
+        ASSERT_TRUE(game);
+        const auto expected = provider.GetAppInstallDirEX(appid);
+        EXPECT_EQ(game->GetName(), expected.GetName());
+        EXPECT_EQ(game->GetInstallPath(), expected.GetInstallPath());
+        EXPECT_EQ(game->GetInstallDir(), expected.GetInstallDir());
+        EXPECT_EQ(game->GetIcon(), expected.GetIcon());
+        EXPECT_EQ(shared.BIsSourceGame(appid), provider.BIsSourceGame(appid));
+        EXPECT_EQ(shared.BIsSource2Game(appid), provider.BIsSource2Game(appid));
+    }
+    EXPECT_FALSE(shared.BIsAppInstalled(424242));
+    EXPECT_FALSE(shared.Find(424242));
+    EXPECT_EQ(shared.GameAt(shared.GetNumInstalledApps()).appid, k_uAppIdInvalid);
+
+    // A refresh publishes the next generation; readers keep theirs until they attach again.
+    tree.AddApp(tree.libraries[1], 90000, "New Game", "New Game", true, false);
+    provider.Refresh();
+    EXPECT_TRUE(shared.IsStale());
+    EXPECT_FALSE(shared.BIsAppInstalled(90000));
+    ASSERT_TRUE(shared.Attach(path));
+    EXPECT_EQ(shared.Generation(), 2u);
+    EXPECT_TRUE(shared.BIsSourceGame(90000));
+
+    // Truncated files are refused.
+    const auto truncated = (tree.Root() / "truncated.snapshot").string();
+    std::filesystem::copy_file(path, truncated);
+    std::filesystem::resize_file(truncated, std::filesystem::file_size(truncated) - 8);
+    EXPECT_FALSE(shared.Attach(truncated));
+    EXPECT_FALSE(shared.BIsAppInstalled(90000));
+
+    // So are files anyone else could have written.
+    const auto writable = (tree.Root() / "writable.snapshot").string();
+    std::filesystem::copy_file(path, writable);
+    std::filesystem::permissions(writable, std::filesystem::perms::others_write, std::filesystem::perm_options::add);
+    EXPECT_FALSE(shared.Attach(writable));
+    std::filesystem::permissions(writable, std::filesystem::perms::others_write, std::filesystem::perm_options::remove);
+    EXPECT_TRUE(shared.Attach(writable));
+}
+
+TEST(SAPP, searchPathResolver) {
+    SappFakeSteamTree tree({.libraries = 1, .manifests = 0});
+    tree.AddApp(tree.libraries[0], 220, "Half-Life 2", "Half-Life 2", true, false);
+    const auto install = std::filesystem::path(tree.libraries[0]) / "steamapps" / "common" / "Half-Life 2";
+    const auto write = [](const std::filesystem::path &file, std::string_view contents) {
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file, std::ios::binary) << contents;
+    };
+    write(install / "hl2" / "gameinfo.txt",
+          "\"GameInfo\"\n{\n\tgame \"Half-Life 2\"\n\t\"FileSystem\"\n\t{\n\t\tSteamAppId 220\n\t\t\"SearchPaths\"\n\t\t{\n"
+          "\t\t\tgame+mod\t|gameinfo_path|custom/*\n"
+          "\t\t\tgame+mod\t|gameinfo_path|.\n"
+          "\t\t\tgame\t\t|all_source_engine_paths|hl2\n"
+          "\t\t\tplatform\t|all_source_engine_paths|platform\n"
+          "\t\t\tGame\t\t|all_source_engine_paths|platform\n"
+          "\t\t}\n\t}\n}\n");
+    write(install / "hl2" / "materials" / "Shared.vmt", "hl2");
+    write(install / "hl2" / "scripts" / "packed.txt", "loose");
+    write(install / "hl2" / "custom" / "mymod" / "materials" / "Shared.vmt", "custom");
+    write(install / "platform" / "scripts" / "Only.txt", "platform");
+
+    // A version 1 VPK holding scripts/packed.txt.
+    std::string directory;
+    directory.append("txt", 4).append("scripts", 8).append("packed", 7);
+    directory.append(4, '\0').append(2, '\0').append("\xff\x7f", 2).append(8, '\0').append("\xff\xff", 2);
+    directory.append(3, '\0');
+    std::string vpk;
+    for (const uint32 field: {0x55AA1234u, 1u, static_cast<uint32>(directory.size())})
+        vpk.append(reinterpret_cast<const char *>(&field), sizeof(field));
+    write(install / "hl2" / "custom" / "pak01_dir.vpk", vpk + directory);
+
+    SteamAppPathProvider provider;
+    ASSERT_EQ(provider.GetGameInfoFiles(220), std::vector<std::string>{(install / "hl2" / "gameinfo.txt").string()});
+    EXPECT_FALSE(provider.GetGameInfo(220, "portal"));
+    const auto info = provider.GetGameInfo(220, "hl2");
+    ASSERT_TRUE(info);
+    EXPECT_EQ(info->GetGame(), "Half-Life 2");
+
+    const auto searchPaths = info->GetSearchPaths();
+    ASSERT_EQ(searchPaths.size(), 6u);
+    EXPECT_EQ(searchPaths[0].path, (install / "hl2" / "custom" / "mymod").string());
+    EXPECT_EQ(searchPaths[1].path, (install / "hl2" / "custom" / "pak01_dir.vpk").string());
+    EXPECT_TRUE(searchPaths[1].vpk);
+    EXPECT_EQ(searchPaths[2].path, (install / "hl2").string());
+    EXPECT_EQ(searchPaths[3].path, (install / "hl2").string());
+    EXPECT_TRUE(searchPaths[2].HasKey("MOD"));
+    EXPECT_FALSE(searchPaths[3].HasKey("mod"));
+    EXPECT_TRUE(searchPaths[5].HasKey("game"));
+
+    const auto index = provider.GetSearchPathIndex(220);
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(provider.GetSearchPathIndex(220), index);
+    // Folder mounts include everything below them: hl2 also holds gameinfo.txt and custom/.
+    EXPECT_EQ(index->GetFileCount(), 6u);
+
+    const auto material = index->Find("MATERIALS\\shared.VMT");
+    ASSERT_TRUE(material);
+    EXPECT_EQ(material->mount, &index->GetGameInfo().GetSearchPaths()[0]);
+    EXPECT_EQ(material->FullPath(), (install / "hl2" / "custom" / "mymod" / "materials" / "Shared.vmt").string());
+    const auto packed = index->Find("scripts/packed.txt");
+    ASSERT_TRUE(packed);
+    EXPECT_TRUE(packed->mount->vpk);
+    EXPECT_EQ(packed->FullPath(), (install / "hl2" / "custom" / "pak01_dir.vpk").string());
+    const auto platform = index->Find("scripts/only.txt");
+    ASSERT_TRUE(platform);
+    EXPECT_EQ(platform->relative, "scripts/Only.txt");
+    EXPECT_EQ(platform->mount->path, (install / "platform").string());
+    EXPECT_FALSE(index->Find("scripts/missing.txt"));
+    EXPECT_FALSE(index->IsStale());
+
+    const auto mods = provider.GetSearchPathIndex(220, "hl2", "mod");
+    ASSERT_NE(mods, nullptr);
+    EXPECT_NE(mods, index);
+    EXPECT_FALSE(mods->Find("scripts/only.txt"));
+
+    // A new file in an indexed folder makes the index stale, but the provider only checks the
+    // gameinfo and keeps handing it out until that changes.
+    write(install / "hl2" / "materials" / "New.vmt", "new");
+    std::filesystem::last_write_time(install / "hl2" / "materials", std::filesystem::file_time_type::clock::now() + std::chrono::seconds(5));
+    EXPECT_TRUE(index->IsStale());
+    EXPECT_EQ(provider.GetSearchPathIndex(220), index);
+    std::filesystem::last_write_time(install / "hl2" / "gameinfo.txt", std::filesystem::file_time_type::clock::now() + std::chrono::seconds(5));
+    const auto rebuilt = provider.GetSearchPathIndex(220);
+    ASSERT_NE(rebuilt, index);
+    EXPECT_TRUE(rebuilt->Find("materials/new.vmt"));
+    EXPECT_FALSE(index->Find("materials/new.vmt"));
+
+    // Refresh() drops every cached index.
+    provider.Refresh();
+    EXPECT_NE(provider.GetSearchPathIndex(220), rebuilt);
+}
+
+TEST(SAPP, installSizes) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 4, .extraFolders = 0});
+    // Mid-update, so SizeOnDisk can't be trusted and the folder is walked instead.
+    tree.AddApp(tree.libraries[1], 7000, "Updating Game", "Updating Game", false, false);
+    const auto manifest = std::filesystem::path(tree.libraries[1]) / "steamapps" / "appmanifest_7000.acf";
+    std::string contents;
+    {
+        std::ifstream in(manifest);
+        contents.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    contents.replace(contents.find("\"StateFlags\"\t\t\"4\""), 17, "\"StateFlags\"\t\t\"6\"");
+    std::ofstream(manifest) << contents;
+
+    const auto install = std::filesystem::path(tree.libraries[1]) / "steamapps" / "common" / "Updating Game";
+    std::uint64_t expected = 0;
+    for (int folder = 0; folder < 20; folder++) {
+        const auto path = install / ("folder" + std::to_string(folder)) / "nested";
+        std::filesystem::create_directories(path);
+        for (int file = 0; file < 10; file++) {
+            std::ofstream(path / ("file" + std::to_string(file)), std::ios::binary) << std::string(folder * 100 + file, 'x');
+            expected += folder * 100 + file;
+        }
+    }
+    // Links to an already counted file and folder add nothing.
+    std::filesystem::create_hard_link(install / "folder19" / "nested" / "file9", install / "hardlink");
+    std::filesystem::create_symlink(install / "folder19", install / "symlink");
+
+    SteamAppPathProvider provider;
+    const auto updating = provider.GetAppInstallSize(7000);
+    ASSERT_TRUE(updating);
+    EXPECT_FALSE(updating->fromManifest);
+    EXPECT_TRUE(updating->complete);
+    EXPECT_EQ(updating->bytes, expected);
+    EXPECT_EQ(updating->files, 200u);
+    EXPECT_FALSE(provider.GetAppInstallSize(424242));
+
+    const auto installed = provider.GetAppInstallSize(tree.appids[0]);
+    ASSERT_TRUE(installed);
+    EXPECT_TRUE(installed->fromManifest);
+    EXPECT_EQ(installed->bytes, tree.appids[0] * 1024ull);
+    const auto walked = provider.GetAppInstallSize(tree.appids[0], {.trustManifest = false});
+    ASSERT_TRUE(walked);
+    EXPECT_FALSE(walked->fromManifest);
+    std::uint64_t onDisk = 0;
+    for (const auto &entry: std::filesystem::recursive_directory_iterator(provider.GetAppInstallDirEX(tree.appids[0]).GetInstallPath()))
+        onDisk += entry.is_regular_file() ? entry.file_size() : 0;
+    EXPECT_EQ(walked->bytes, onDisk);
+
+    for (const auto &options: {SappDiskUsageOptions{.maxConcurrency = 1}, SappDiskUsageOptions{.maxConcurrency = 4},
+                               SappDiskUsageOptions{.maxConcurrency = 4, .useIoUring = true}}) {
+        const auto report = provider.GetDiskUsage(options);
+        EXPECT_TRUE(report.complete);
+        ASSERT_EQ(report.apps.size(), provider.GetNumInstalledApps());
+        ASSERT_EQ(report.libraries.size(), 2u);
+        std::uint64_t total = 0;
+        for (const auto &app: report.apps) {
+            const auto game = provider.GetAppInstallDirEX(app.appid);
+            EXPECT_EQ(report.libraries[app.library].path, game.GetLibrary());
+            EXPECT_EQ(app.bytes, app.appid == 7000 ? expected : app.appid * 1024ull);
+            total += app.bytes;
+        }
+        EXPECT_EQ(report.libraries[0].bytes + report.libraries[1].bytes, total);
+        EXPECT_EQ(report.libraries[0].apps + report.libraries[1].apps, report.apps.size());
+    }
+
+    // A stopped walk keeps the manifest sizes and marks the walked installs incomplete.
+    std::stop_source stop;
+    stop.request_stop();
+    const auto report = provider.GetDiskUsage({.stop = stop.get_token()});
+    EXPECT_FALSE(report.complete);
+    for (const auto &app: report.apps)
+        EXPECT_EQ(app.complete, app.appid != 7000);
+}
+
+TEST(SAPP, sortOrders) {
+    SappFakeSteamTree tree({.libraries = 3, .manifests = 0});
+    const std::vector<std::pair<AppId_t, std::string>> apps{{500, "beta"}, {20, "Alpha"}, {7000, "gamma"}, {310, "alpha"}, {90, "Delta"}};
+    for (std::size_t i = 0; i < apps.size(); i++)
+        tree.AddApp(tree.libraries[i % 3], apps[i].first, apps[i].second, apps[i].second + std::to_string(i), false, false);
+
+    SteamAppPathProvider provider;
+    const auto snapshot = provider.GetSnapshot();
+    const auto *storage = snapshot->GetGames().data();
+    auto appidsBy = [&](SappSortKey key) {
+        std::vector<AppId_t> appids;
+        for (const auto &game: snapshot->GetGamesBy(key))
+            appids.push_back(game.appid);
+        return appids;
+    };
+
+    EXPECT_EQ(appidsBy(SappSortKey::AppId), (std::vector<AppId_t>{20, 90, 310, 500, 7000}));
+    EXPECT_EQ(appidsBy(SappSortKey::Name), (std::vector<AppId_t>{20, 310, 500, 90, 7000}));
+    // Fixture sizes are appid * 1024.
+    EXPECT_EQ(appidsBy(SappSortKey::Size), (std::vector<AppId_t>{20, 90, 310, 500, 7000}));
+    const auto byLibrary = appidsBy(SappSortKey::Library);
+    ASSERT_EQ(byLibrary.size(), apps.size());
+    for (std::size_t i = 1; i < byLibrary.size(); i++)
+        EXPECT_LE(provider.GetAppInstallDirEX(byLibrary[i - 1]).GetLibrary(), provider.GetAppInstallDirEX(byLibrary[i]).GetLibrary());
+
+    // Cached per snapshot, and nothing moved.
+    EXPECT_EQ(snapshot->GetOrder(SappSortKey::Name).data(), snapshot->GetOrder(SappSortKey::Name).data());
+    EXPECT_EQ(snapshot->GetGames().data(), storage);
+
+    // Orders from many threads at once agree.
+    std::vector<std::jthread> readers;
+    std::atomic<int> mismatches{0};
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&] {
+            const auto fresh = std::make_shared<const SappSnapshot>(*snapshot);
+            for (const auto key: {SappSortKey::Library, SappSortKey::Name, SappSortKey::Size}) {
+                const auto order = fresh->GetOrder(key);
+                if (!std::ranges::equal(order, snapshot->GetOrder(key)))
+                    mismatches++;
+            }
+        });
+    }
+    readers.clear();
+    EXPECT_EQ(mismatches, 0);
+
+    // sortGames reorders the list of the next snapshot; the orders carried over still name the same games.
+    provider.sortGames(false);
+    const auto sorted = provider.GetSnapshot();
+    EXPECT_TRUE(std::is_sorted(sorted->GetAppIds().begin(), sorted->GetAppIds().end(), std::greater<>()));
+    for (const auto key: {SappSortKey::AppId, SappSortKey::Name, SappSortKey::Library, SappSortKey::Size}) {
+        std::vector<AppId_t> appids;
+        for (const auto &game: sorted->GetGamesBy(key))
+            appids.push_back(game.appid);
+        EXPECT_EQ(appids, appidsBy(key));
+    }
+    EXPECT_EQ(sorted->GetOrder(SappSortKey::AppId).front(), sorted->GetNumInstalledApps() - 1);
+}
+
+TEST(SAPP, workshopContent) {
+    SappFakeSteamTree tree({.libraries = 2, .manifests = 6});
+    const auto appid = tree.appids[1];
+    const auto library = std::filesystem::path(tree.libraries[1]) / "steamapps";
+    const auto writeManifest = [&](std::initializer_list<std::uint64_t> ids) {
+        std::filesystem::create_directories(library / "workshop");
+        std::ofstream out(library / "workshop" / ("appworkshop_" + std::to_string(appid) + ".acf"));
+        out << "\"AppWorkshop\"\n{\n\t\"appid\"\t\t\"" << appid << "\"\n\t\"SizeOnDisk\"\t\t\"3000\"\n\t\"NeedsUpdate\"\t\t\"0\"\n\t\"NeedsDownload\"\t\t\"1\"\n"
+            << "\t\"WorkshopItemsInstalled\"\n\t{\n";
+        for (const auto id: ids) {
+            out << "\t\t\"" << id << "\"\n\t\t{\n\t\t\t\"size\"\t\t\"" << id % 1000 << "\"\n\t\t\t\"timeupdated\"\t\t\"" << 1600000000 + id % 1000
+                << "\"\n\t\t\t\"manifest\"\t\t\"123\"\n\t\t}\n";
+            std::filesystem::create_directories(library / "workshop" / "content" / std::to_string(appid) / std::to_string(id));
+        }
+        out << "\t}\n\t\"WorkshopItemDetails\"\n\t{\n";
+        for (const auto id: ids)
+            out << "\t\t\"" << id << "\"\n\t\t{\n\t\t\t\"timetouched\"\t\t\"" << 1700000000 + id % 1000 << "\"\n\t\t\t\"subscribedby\"\t\t\"42\"\n\t\t}\n";
+        out << "\t}\n}\n";
+    };
+    writeManifest({3000000002, 1000000001});
+
+    SteamAppPathProvider provider;
+    EXPECT_EQ(provider.GetWorkshopContent(tree.appids[0]), nullptr);
+    EXPECT_EQ(provider.GetWorkshopContent(424242), nullptr);
+
+    const auto content = provider.GetWorkshopContent(appid);
+    ASSERT_NE(content, nullptr);
+    EXPECT_EQ(provider.GetWorkshopContent(appid), content);
+    EXPECT_EQ(content->GetSizeOnDisk(), 3000u);
+    EXPECT_TRUE(content->NeedsDownload());
+    EXPECT_FALSE(content->NeedsUpdate());
+    ASSERT_EQ(content->GetItems().size(), 2u);
+    const auto &item = content->GetItems()[0];
+    EXPECT_EQ(item.id, 1000000001u);
+    EXPECT_EQ(item.size, 1u);
+    EXPECT_EQ(item.timeUpdated, 1600000001u);
+    EXPECT_EQ(item.timeTouched, 1700000001u);
+    EXPECT_EQ(item.path, (library / "workshop" / "content" / std::to_string(appid) / "1000000001").string());
+    EXPECT_TRUE(std::filesystem::is_directory(item.path));
+    ASSERT_NE(content->Find(3000000002), nullptr);
+    EXPECT_EQ(content->Find(3000000002)->size, 2u);
+    EXPECT_EQ(content->Find(5), nullptr);
+
+    // A changed manifest is read again, holders of the old content keep it.
+    writeManifest({1000000001, 2000000003, 3000000002});
+    std::filesystem::last_write_time(content->GetManifest(), std::filesystem::file_time_type::clock::now() + std::chrono::seconds(5));
+    EXPECT_TRUE(content->IsStale());
+    const auto reloaded = provider.GetWorkshopContent(appid);
+    ASSERT_NE(reloaded, nullptr);
+    EXPECT_EQ(reloaded->GetItems().size(), 3u);
+    EXPECT_EQ(content->GetItems().size(), 2u);
+
+    const auto snapshot = provider.GetSnapshot();
+    const auto all = provider.GetWorkshopContent(snapshot->GetAppIds(), 4);
+    ASSERT_EQ(all.size(), snapshot->GetNumInstalledApps());
+    for (std::size_t i = 0; i < all.size(); i++)
+        EXPECT_EQ(all[i] != nullptr, snapshot->GetAppIds()[i] == appid);
+
+    EXPECT_EQ(provider.GetSnapshot()->GetLibraryPaths().size(), tree.libraries.size());
+    EXPECT_TRUE(provider.GetDownloadingApps().empty());
+    std::filesystem::create_directories(library / "downloading" / "99999");
+    std::filesystem::create_directories(std::filesystem::path(tree.libraries[0]) / "steamapps" / "downloading" / std::to_string(tree.appids[0]));
+    std::ofstream(library / "downloading" / "state_99999_100.patch") << "x";
+    const auto downloading = provider.GetDownloadingApps();
+    ASSERT_EQ(downloading.size(), 2u);
+    EXPECT_EQ(downloading[0].appid, tree.appids[0]);
+    EXPECT_EQ(downloading[1].appid, 99999u);
+    EXPECT_EQ(downloading[1].path, (library / "downloading" / "99999").string());
+}